@@ -0,0 +1,481 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fake_compositor.h"
+
+#include <wayland-server.h>
+
+#include <boost/throw_exception.hpp>
+
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <set>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace
+{
+auto now_ms() -> uint32_t
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void destroy_resource(wl_client*, wl_resource* resource)
+{
+    wl_resource_destroy(resource);
+}
+
+// Requests we accept and ignore
+void ignore_region_rectangle(wl_client*, wl_resource*, int32_t, int32_t, int32_t, int32_t) {}
+void ignore_region(wl_client*, wl_resource*, wl_resource*) {}
+void ignore_int(wl_client*, wl_resource*, int32_t) {}
+void ignore(wl_client*, wl_resource*) {}
+
+struct wl_region_interface const region_impl{
+    .destroy = &destroy_resource,
+    .add = &ignore_region_rectangle,
+    .subtract = &ignore_region_rectangle,
+};
+
+struct wl_pointer_interface const pointer_impl{
+    .set_cursor = [](wl_client*, wl_resource*, uint32_t, wl_resource*, int32_t, int32_t) {},
+    .release = &destroy_resource,
+};
+
+struct wl_keyboard_interface const keyboard_impl{
+    .release = &destroy_resource,
+};
+
+struct wl_touch_interface const touch_impl{
+    .release = &destroy_resource,
+};
+
+struct wl_output_interface const output_impl{
+    .release = &destroy_resource,
+};
+
+struct wl_shell_surface_interface const shell_surface_impl{
+    .pong = [](wl_client*, wl_resource*, uint32_t) {},
+    .move = [](wl_client*, wl_resource*, wl_resource*, uint32_t) {},
+    .resize = [](wl_client*, wl_resource*, wl_resource*, uint32_t, uint32_t) {},
+    .set_toplevel = &ignore,
+    .set_transient = [](wl_client*, wl_resource*, wl_resource*, int32_t, int32_t, uint32_t) {},
+    .set_fullscreen = [](wl_client*, wl_resource*, uint32_t, uint32_t, wl_resource*) {},
+    .set_popup = [](wl_client*, wl_resource*, wl_resource*, uint32_t, wl_resource*, int32_t, int32_t, uint32_t) {},
+    .set_maximized = &ignore_region,
+    .set_title = [](wl_client*, wl_resource*, char const*) {},
+    .set_class = [](wl_client*, wl_resource*, char const*) {},
+};
+
+struct wl_shell_interface const shell_impl{
+    .get_shell_surface = [](wl_client* client, wl_resource* resource, uint32_t id, wl_resource*)
+        {
+            auto const shell_surface = wl_resource_create(client, &wl_shell_surface_interface, 1, id);
+            wl_resource_set_implementation(shell_surface, &shell_surface_impl, nullptr, nullptr);
+        },
+};
+}
+
+struct FakeCompositor::Self
+{
+    Self();
+    ~Self();
+
+    // Runs work on the compositor thread
+    void post(std::function<void()> work);
+
+    // Bookkeeping touched only on the compositor thread
+    struct Surface
+    {
+        Self* self;
+        wl_resource* pending_buffer = nullptr;
+        std::vector<wl_resource*> frame_callbacks;
+    };
+
+    struct Output
+    {
+        OutputState state;
+        wl_global* global;
+        std::vector<wl_resource*> resources;
+    };
+
+    // Forgets a held buffer when the client destroys it
+    struct HeldBuffer : wl_listener
+    {
+        Self* self;
+
+        static void destroyed(wl_listener* listener, void* data)
+        {
+            static_cast<HeldBuffer*>(listener)->self->held.erase(static_cast<wl_resource*>(data));
+            wl_list_remove(&listener->link);
+            delete static_cast<HeldBuffer*>(listener);
+        }
+    };
+
+    static void send_state(wl_resource* resource, OutputState const& state);
+    void hold(wl_resource* buffer);
+    void committed();
+
+    wl_display* const display;
+    wl_event_loop* const loop;
+    int const work_signal;
+    wl_event_source* work_source;
+
+    std::map<int, std::unique_ptr<Output>> outputs;
+    int next_output = 0;
+
+    uint32_t seat_capabilities = 0;
+    std::vector<wl_resource*> seats;
+
+    // Buffers committed and not yet released
+    std::set<wl_resource*> held;
+
+    std::mutex mutable mutex;
+    std::condition_variable mutable cv;
+    uint64_t commit_count = 0;
+    std::vector<std::function<void()>> work;
+
+    std::thread thread;
+
+    static struct wl_surface_interface const surface_impl;
+    static struct wl_compositor_interface const compositor_impl;
+    static struct wl_seat_interface const seat_impl;
+};
+
+struct wl_surface_interface const FakeCompositor::Self::surface_impl{
+    .destroy = &destroy_resource,
+    .attach = [](wl_client*, wl_resource* resource, wl_resource* buffer, int32_t, int32_t)
+        {
+            static_cast<Surface*>(wl_resource_get_user_data(resource))->pending_buffer = buffer;
+        },
+    .damage = &ignore_region_rectangle,
+    .frame = [](wl_client* client, wl_resource* resource, uint32_t id)
+        {
+            auto const callback = wl_resource_create(client, &wl_callback_interface, 1, id);
+            wl_resource_set_implementation(callback, nullptr, nullptr, nullptr);
+            static_cast<Surface*>(wl_resource_get_user_data(resource))->frame_callbacks.push_back(callback);
+        },
+    .set_opaque_region = &ignore_region,
+    .set_input_region = &ignore_region,
+    .commit = [](wl_client*, wl_resource* resource)
+        {
+            auto const surface = static_cast<Surface*>(wl_resource_get_user_data(resource));
+
+            // We "present" immediately
+            for (auto const callback : surface->frame_callbacks)
+            {
+                wl_callback_send_done(callback, now_ms());
+                wl_resource_destroy(callback);
+            }
+            surface->frame_callbacks.clear();
+
+            if (surface->pending_buffer)
+            {
+                surface->self->hold(surface->pending_buffer);
+                surface->pending_buffer = nullptr;
+                surface->self->committed();
+            }
+        },
+    .set_buffer_transform = &ignore_int,
+    .set_buffer_scale = &ignore_int,
+    .damage_buffer = &ignore_region_rectangle,
+};
+
+struct wl_compositor_interface const FakeCompositor::Self::compositor_impl{
+    .create_surface = [](wl_client* client, wl_resource* resource, uint32_t id)
+        {
+            auto const surface = wl_resource_create(client, &wl_surface_interface, wl_resource_get_version(resource), id);
+            auto const self = static_cast<Self*>(wl_resource_get_user_data(resource));
+            // Pending frame callbacks go with the client
+            wl_resource_set_implementation(surface, &surface_impl, new Surface{self}, [](wl_resource* resource)
+                {
+                    delete static_cast<Surface*>(wl_resource_get_user_data(resource));
+                });
+        },
+    .create_region = [](wl_client* client, wl_resource* resource, uint32_t id)
+        {
+            auto const region = wl_resource_create(client, &wl_region_interface, 1, id);
+            wl_resource_set_implementation(region, &region_impl, nullptr, nullptr);
+        },
+};
+
+struct wl_seat_interface const FakeCompositor::Self::seat_impl{
+    .get_pointer = [](wl_client* client, wl_resource* resource, uint32_t id)
+        {
+            auto const pointer = wl_resource_create(client, &wl_pointer_interface, wl_resource_get_version(resource), id);
+            wl_resource_set_implementation(pointer, &pointer_impl, nullptr, nullptr);
+        },
+    .get_keyboard = [](wl_client* client, wl_resource* resource, uint32_t id)
+        {
+            auto const keyboard = wl_resource_create(client, &wl_keyboard_interface, wl_resource_get_version(resource), id);
+            wl_resource_set_implementation(keyboard, &keyboard_impl, nullptr, nullptr);
+        },
+    .get_touch = [](wl_client* client, wl_resource* resource, uint32_t id)
+        {
+            auto const touch = wl_resource_create(client, &wl_touch_interface, wl_resource_get_version(resource), id);
+            wl_resource_set_implementation(touch, &touch_impl, nullptr, nullptr);
+        },
+    .release = &destroy_resource,
+};
+
+FakeCompositor::Self::Self() :
+    display{wl_display_create()},
+    loop{wl_display_get_event_loop(display)},
+    work_signal{eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)}
+{
+    if (work_signal < 0)
+    {
+        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to create event fd"}));
+    }
+
+    work_source = wl_event_loop_add_fd(loop, work_signal, WL_EVENT_READABLE, [](int fd, uint32_t, void* data)
+        {
+            eventfd_t ignored;
+            eventfd_read(fd, &ignored);
+
+            auto const self = static_cast<Self*>(data);
+            decltype(self->work) work;
+            {
+                std::lock_guard<decltype(self->mutex)> lock{self->mutex};
+                std::swap(work, self->work);
+            }
+
+            for (auto const& w : work)
+                w();
+
+            return 0;
+        }, this);
+
+    wl_display_init_shm(display);
+    wl_display_add_shm_format(display, WL_SHM_FORMAT_RGB565);
+
+    wl_global_create(display, &wl_compositor_interface, 3, this, [](wl_client* client, void* data, uint32_t version, uint32_t id)
+        {
+            auto const resource = wl_resource_create(client, &wl_compositor_interface, version, id);
+            wl_resource_set_implementation(resource, &compositor_impl, data, nullptr);
+        });
+
+    wl_global_create(display, &wl_shell_interface, 1, this, [](wl_client* client, void*, uint32_t version, uint32_t id)
+        {
+            auto const resource = wl_resource_create(client, &wl_shell_interface, version, id);
+            wl_resource_set_implementation(resource, &shell_impl, nullptr, nullptr);
+        });
+
+    wl_global_create(display, &wl_seat_interface, 5, this, [](wl_client* client, void* data, uint32_t version, uint32_t id)
+        {
+            auto const self = static_cast<Self*>(data);
+            auto const resource = wl_resource_create(client, &wl_seat_interface, version, id);
+            wl_resource_set_implementation(resource, &seat_impl, self, [](wl_resource* resource)
+                {
+                    auto const self = static_cast<Self*>(wl_resource_get_user_data(resource));
+                    self->seats.erase(std::remove(begin(self->seats), end(self->seats), resource), end(self->seats));
+                });
+            self->seats.push_back(resource);
+
+            wl_seat_send_capabilities(resource, self->seat_capabilities);
+            if (version >= WL_SEAT_NAME_SINCE_VERSION)
+                wl_seat_send_name(resource, "seat0");
+        });
+
+    thread = std::thread{[this] { wl_display_run(display); }};
+}
+
+FakeCompositor::Self::~Self()
+{
+    post([this] { wl_display_terminate(display); });
+    thread.join();
+
+    wl_display_destroy_clients(display);
+    wl_event_source_remove(work_source);
+    wl_display_destroy(display);
+    close(work_signal);
+}
+
+void FakeCompositor::Self::post(std::function<void()> work)
+{
+    {
+        std::lock_guard<decltype(mutex)> lock{mutex};
+        this->work.push_back(std::move(work));
+    }
+    eventfd_write(work_signal, 1);
+}
+
+void FakeCompositor::Self::send_state(wl_resource* resource, OutputState const& state)
+{
+    wl_output_send_geometry(
+        resource, state.x, state.y, 0, 0, WL_OUTPUT_SUBPIXEL_UNKNOWN, "Fake", "Output", state.transform);
+    wl_output_send_mode(
+        resource, WL_OUTPUT_MODE_CURRENT | WL_OUTPUT_MODE_PREFERRED, state.width, state.height, state.refresh_mhz);
+
+    if (wl_resource_get_version(resource) >= WL_OUTPUT_SCALE_SINCE_VERSION)
+        wl_output_send_scale(resource, state.scale);
+
+    if (wl_resource_get_version(resource) >= WL_OUTPUT_DONE_SINCE_VERSION)
+        wl_output_send_done(resource);
+}
+
+void FakeCompositor::Self::hold(wl_resource* buffer)
+{
+    // The client may destroy a buffer we hold
+    if (!wl_resource_get_destroy_listener(buffer, &HeldBuffer::destroyed))
+    {
+        auto const listener = new HeldBuffer{};
+        listener->notify = &HeldBuffer::destroyed;
+        listener->self = this;
+        wl_resource_add_destroy_listener(buffer, listener);
+    }
+
+    held.insert(buffer);
+}
+
+void FakeCompositor::Self::committed()
+{
+    {
+        std::lock_guard<decltype(mutex)> lock{mutex};
+        ++commit_count;
+    }
+    cv.notify_all();
+}
+
+FakeCompositor::FakeCompositor() :
+    self{std::make_unique<Self>()}
+{
+}
+
+FakeCompositor::~FakeCompositor() = default;
+
+auto FakeCompositor::connect() -> int
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+    {
+        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to create socket pair"}));
+    }
+
+    self->post([self=self.get(), fd=fds[0]] { wl_client_create(self->display, fd); });
+    return fds[1];
+}
+
+auto FakeCompositor::add_output(OutputState const& state) -> int
+{
+    std::promise<int> id;
+    self->post([self=self.get(), state, &id]
+        {
+            auto output = std::make_unique<Self::Output>();
+            output->state = state;
+            output->global = wl_global_create(self->display, &wl_output_interface, 2, output.get(),
+                [](wl_client* client, void* data, uint32_t version, uint32_t id)
+                {
+                    auto const output = static_cast<Self::Output*>(data);
+                    auto const resource = wl_resource_create(client, &wl_output_interface, version, id);
+                    wl_resource_set_implementation(resource, &output_impl, output, [](wl_resource* resource)
+                        {
+                            // Null once the output has been removed
+                            if (auto const output = static_cast<Self::Output*>(wl_resource_get_user_data(resource)))
+                            {
+                                auto& resources = output->resources;
+                                resources.erase(std::remove(begin(resources), end(resources), resource), end(resources));
+                            }
+                        });
+                    output->resources.push_back(resource);
+                    Self::send_state(resource, output->state);
+                });
+
+            auto const next = self->next_output++;
+            self->outputs[next] = std::move(output);
+            id.set_value(next);
+        });
+
+    return id.get_future().get();
+}
+
+void FakeCompositor::change_output(int id, OutputState const& state)
+{
+    self->post([self=self.get(), id, state]
+        {
+            auto const i = self->outputs.find(id);
+            if (i == self->outputs.end())
+                return;
+
+            i->second->state = state;
+            for (auto const resource : i->second->resources)
+                Self::send_state(resource, state);
+        });
+}
+
+void FakeCompositor::remove_output(int id)
+{
+    self->post([self=self.get(), id]
+        {
+            auto const i = self->outputs.find(id);
+            if (i == self->outputs.end())
+                return;
+
+            for (auto const resource : i->second->resources)
+                wl_resource_set_user_data(resource, nullptr);
+
+            wl_global_destroy(i->second->global);
+            self->outputs.erase(i);
+        });
+}
+
+void FakeCompositor::set_seat_capabilities(uint32_t capabilities)
+{
+    self->post([self=self.get(), capabilities]
+        {
+            self->seat_capabilities = capabilities;
+            for (auto const seat : self->seats)
+                wl_seat_send_capabilities(seat, capabilities);
+        });
+}
+
+void FakeCompositor::release_buffers()
+{
+    self->post([self=self.get()]
+        {
+            for (auto const buffer : self->held)
+                wl_buffer_send_release(buffer);
+            self->held.clear();
+        });
+}
+
+auto FakeCompositor::commits() const -> uint64_t
+{
+    std::lock_guard<decltype(self->mutex)> lock{self->mutex};
+    return self->commit_count;
+}
+
+auto FakeCompositor::wait_for_commits(uint64_t count, std::chrono::milliseconds timeout) const -> bool
+{
+    std::unique_lock<decltype(self->mutex)> lock{self->mutex};
+    return self->cv.wait_for(lock, timeout, [&] { return self->commit_count >= count; });
+}
+
+void FakeCompositor::sync()
+{
+    std::promise<void> done;
+    self->post([&done] { done.set_value(); });
+    done.get_future().wait();
+}
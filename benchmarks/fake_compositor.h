@@ -0,0 +1,76 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_FAKE_COMPOSITOR_H
+#define FRAME_FAKE_COMPOSITOR_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+/// A minimal in-process Wayland compositor (on libwayland-server) for exercising FullscreenClient without Mir.
+///
+/// It advertises wl_compositor, wl_shm, wl_seat, wl_shell and scriptable wl_outputs, counts surface commits and
+/// holds committed buffers until told to release them. Requests are handled on the compositor's own thread; the
+/// scripting functions are safe to call from any thread and take effect in order.
+class FakeCompositor
+{
+public:
+    struct OutputState
+    {
+        int32_t x = 0;
+        int32_t y = 0;
+        int32_t width = 1920;
+        int32_t height = 1080;
+        int32_t scale = 1;
+        int32_t transform = 0;          // WL_OUTPUT_TRANSFORM_*
+        int32_t refresh_mhz = 60000;
+    };
+
+    FakeCompositor();
+    ~FakeCompositor();
+
+    FakeCompositor(FakeCompositor const&) = delete;
+    FakeCompositor& operator=(FakeCompositor const&) = delete;
+
+    /// A socket for a new client connection, to pass to wl_display_connect_to_fd()
+    auto connect() -> int;
+
+    /// Returns an id for change_output() and remove_output()
+    auto add_output(OutputState const& state) -> int;
+    void change_output(int id, OutputState const& state);
+    void remove_output(int id);
+
+    void set_seat_capabilities(uint32_t capabilities);
+
+    /// Sends release for every committed buffer not yet released
+    void release_buffers();
+
+    /// Surface commits with a buffer attached
+    auto commits() const -> uint64_t;
+
+    /// Waits for commits() to reach count, returning false on timeout
+    auto wait_for_commits(uint64_t count, std::chrono::milliseconds timeout) const -> bool;
+
+    /// Waits until the compositor has handled everything scripted so far
+    void sync();
+
+private:
+    struct Self;
+    std::unique_ptr<Self> const self;
+};
+
+#endif // FRAME_FAKE_COMPOSITOR_H
@@ -0,0 +1,189 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Times FullscreenClient's startup, hotplug, mode change and redraw paths against FakeCompositor, so they can be
+// measured on any machine without Mir or a display.
+
+#include "fake_compositor.h"
+#include "egfullscreenclient.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+auto constexpr timeout = std::chrono::seconds{5};
+
+// Draws a solid buffer per output, touching every page as a real client would
+class TestClient : public egmde::FullscreenClient
+{
+public:
+    explicit TestClient(wl_display* display) :
+        FullscreenClient(display)
+    {
+        wl_display_roundtrip(display);
+        wl_display_roundtrip(display);
+    }
+
+    void draw_screen(SurfaceInfo& info) const override
+    {
+        auto const width = info.output->width;
+        auto const height = info.output->height;
+
+        if (width <= 0 || height <= 0)
+            return;
+
+        if (!info.surface)
+        {
+            info.surface = wl_compositor_create_surface(compositor);
+        }
+
+        if (!info.shell_surface)
+        {
+            info.shell_surface = wl_shell_get_shell_surface(shell, info.surface);
+            wl_shell_surface_set_fullscreen(
+                info.shell_surface, WL_SHELL_SURFACE_FULLSCREEN_METHOD_DEFAULT, 0, info.output->output);
+        }
+
+        if (info.buffer)
+        {
+            wl_buffer_destroy(info.buffer);
+        }
+
+        auto const stride = 4*width;
+        {
+            auto const shm_pool = make_shm_pool(stride*height, &info.content_area);
+            info.buffer = wl_shm_pool_create_buffer(shm_pool.get(), 0, width, height, stride, WL_SHM_FORMAT_ARGB8888);
+        }
+
+        memset(info.content_area, 0x40, stride*height);
+        unmap_shm(info.content_area, stride*height);
+        info.content_area = nullptr;
+
+        wl_surface_attach(info.surface, info.buffer, 0, 0);
+        wl_surface_commit(info.surface);
+    }
+};
+
+class Samples
+{
+public:
+    void add(Clock::duration duration)
+    {
+        ms.push_back(std::chrono::duration<double, std::milli>{duration}.count());
+    }
+
+    void print(char const* name)
+    {
+        if (ms.empty())
+        {
+            printf("%-28s %6s\n", name, "-");
+            return;
+        }
+
+        std::sort(begin(ms), end(ms));
+        auto const mean = std::accumulate(begin(ms), end(ms), 0.0)/ms.size();
+        printf("%-28s %6zu %9.3f %9.3f %9.3f\n", name, ms.size(), mean, ms[ms.size()/2], ms.back());
+    }
+
+private:
+    std::vector<double> ms;
+};
+
+// Runs action then waits for count more commits, adding the time taken (or complaining on timeout)
+template<typename Action>
+void time_commits(FakeCompositor& compositor, Samples& samples, uint64_t count, Action action)
+{
+    auto const expected = compositor.commits() + count;
+    auto const start = Clock::now();
+    action();
+
+    if (compositor.wait_for_commits(expected, timeout))
+    {
+        samples.add(Clock::now() - start);
+    }
+    else
+    {
+        fprintf(stderr, "Timed out waiting for %llu commits\n", static_cast<unsigned long long>(count));
+    }
+}
+}
+
+int main(int argc, char const* argv[])
+{
+    auto const iterations = argc > 1 ? std::max(atoi(argv[1]), 1) : 100;
+
+    FakeCompositor compositor;
+    compositor.add_output({0, 0, 1920, 1080});
+
+    Samples startup;
+    Samples hotplug;
+    Samples mode_change;
+    Samples scale_change;
+    Samples redraw;
+
+    auto const display = wl_display_connect_to_fd(compositor.connect());
+    if (!display)
+    {
+        fprintf(stderr, "Failed to connect to the fake compositor\n");
+        return EXIT_FAILURE;
+    }
+
+    {
+        std::unique_ptr<TestClient> client;
+        time_commits(compositor, startup, 1, [&] { client = std::make_unique<TestClient>(display); });
+
+        std::thread runner{[&] { client->run(display); }};
+
+        for (auto i = 0; i != iterations; ++i)
+        {
+            int id = -1;
+            time_commits(compositor, hotplug, 1, [&] { id = compositor.add_output({1920, 0, 1920, 1080}); });
+            time_commits(compositor, mode_change, 1, [&] { compositor.change_output(id, {1920, 0, 1280, 720}); });
+            time_commits(compositor, scale_change, 1, [&] { compositor.change_output(id, {1920, 0, 1280, 720, 2}); });
+
+            compositor.release_buffers();
+            time_commits(compositor, redraw, 2, [&] { client->invoke([&] { client->redraw(); }); });
+
+            compositor.remove_output(id);
+            compositor.sync();
+        }
+
+        client->stop();
+        runner.join();
+    }
+
+    wl_display_disconnect(display);
+
+    printf("%-28s %6s %9s %9s %9s\n", "scenario (until committed)", "count", "mean ms", "p50 ms", "max ms");
+    startup.print("connect and first draw");
+    hotplug.print("output added");
+    mode_change.print("output mode changed");
+    scale_change.print("output scale changed");
+    redraw.print("redraw of two outputs");
+    printf("%llu commits\n", static_cast<unsigned long long>(compositor.commits()));
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,259 @@
+#!/usr/bin/env python3
+#
+# Copyright © 2022 Canonical Ltd.
+#
+# This program is free software: you can redistribute it and/or modify
+# under the terms of the GNU General Public License version 2 or 3 as
+# published by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+"""Measures the steady state memory footprint of frame across virtual output configurations.
+
+Each configuration starts frame headless on Mir's virtual display platform, waits for memory use to settle and
+records it. It then reconfigures the outputs (toggling rotation by rewriting frame.display) a number of times,
+lets it settle and records it again. Results are printed as a table and written as JSON.
+"""
+
+import argparse
+import itertools
+import json
+import os
+import re
+import signal
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+RESOLUTIONS = {
+    "720p": (1280, 720),
+    "1080p": (1920, 1080),
+    "1440p": (2560, 1440),
+    "4k": (3840, 2160),
+    "8k": (7680, 4320),
+}
+
+def parse_list(text, convert=str):
+    return [convert(item) for item in text.split(",") if item]
+
+
+def memory_of(pid, runtime_dir):
+    """RSS, PSS and anonymous memory from smaps_rollup, and the resident shm mappings from smaps (all in kB)"""
+    result = {}
+    with open(f"/proc/{pid}/smaps_rollup") as rollup:
+        for line in rollup:
+            key, _, value = line.partition(":")
+            if key in ("Rss", "Pss", "Anonymous"):
+                result[key.lower()] = int(value.split()[0])
+
+    # Our shm pools are unlinked O_TMPFILEs in $XDG_RUNTIME_DIR (or /dev/shm or /tmp), clients may use memfds
+    shm = 0
+    mapping = None
+    with open(f"/proc/{pid}/smaps") as smaps:
+        for line in smaps:
+            if re.match(r"^[0-9a-f]+-[0-9a-f]+ ", line):
+                fields = line.split(maxsplit=5)
+                path = fields[5].strip() if len(fields) > 5 else ""
+                unlinked_file = path.endswith("(deleted)") and path.startswith(("/dev/shm/", runtime_dir, "/tmp/"))
+                mapping = unlinked_file or path.startswith("/memfd:")
+            elif mapping and line.startswith("Rss:"):
+                shm += int(line.split()[1])
+    result["shm"] = shm
+    return result
+
+
+def statistics_of(socket_path):
+    """Frame's own view of its internal client shm use, from the statistics socket"""
+    try:
+        with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as connection:
+            connection.settimeout(2)
+            connection.connect(socket_path)
+            text = b""
+            while chunk := connection.recv(65536):
+                text += chunk
+    except OSError:
+        return {}
+
+    for line in text.decode().splitlines():
+        if line.startswith("frame_internal_client_shm_bytes "):
+            return {"internal_client_shm": int(line.split()[1]) // 1024}
+    return {}
+
+
+def settle(pid, runtime_dir, timeout, interval=0.5, samples=4, tolerance=0.01):
+    """Waits until RSS has been within tolerance for a number of samples, returns the last measurement"""
+    history = []
+    deadline = time.monotonic() + timeout
+    while True:
+        memory = memory_of(pid, runtime_dir)
+        history = (history + [memory["rss"]])[-samples:]
+        if len(history) == samples and max(history) - min(history) <= tolerance * max(history):
+            memory["settled"] = True
+            return memory
+        if time.monotonic() > deadline:
+            memory["settled"] = False
+            return memory
+        time.sleep(interval)
+
+
+def wait_for(predicate, timeout, what):
+    deadline = time.monotonic() + timeout
+    while not predicate():
+        if time.monotonic() > deadline:
+            raise RuntimeError(f"Timed out waiting for {what}")
+        time.sleep(0.1)
+
+
+def output_names(display_file):
+    """The output names from the display configuration frame writes on startup"""
+    names = []
+    with open(display_file) as layouts:
+        for line in layouts:
+            match = re.match(r"^      ([^\s#][^:]*):\s*(#.*)?$", line)
+            if match:
+                names.append(match.group(1))
+            elif "(disconnected)" in line and names:
+                names.pop()
+    return names
+
+
+def write_layout(display_file, names, size, scale, rotated):
+    """A layout placing the outputs side by side"""
+    width, height = size
+    lines = ["layouts:", "  default:", "    cards:", "    - card-id: 0"]
+    x = 0
+    for name in names:
+        lines += [
+            f"      {name}:",
+            "        state: enabled",
+            f"        mode: {width}x{height}",
+            f"        position: [{x}, 0]",
+            f"        orientation: {'left' if rotated else 'normal'}",
+            f"        scale: {scale}",
+        ]
+        x += (height if rotated else width) // scale
+
+    # Write then rename, as the configure hook does, so frame never reads a partial file
+    with open(display_file + ".new", "w") as layout:
+        layout.write("\n".join(lines) + "\n")
+    os.rename(display_file + ".new", display_file)
+
+
+def measure(args, outputs, resolution, scale, rotated):
+    size = RESOLUTIONS[resolution]
+    with tempfile.TemporaryDirectory(prefix="frame-memory-") as work_dir:
+        runtime_dir = os.path.join(work_dir, "runtime")
+        config_dir = os.path.join(work_dir, "config")
+        os.makedirs(runtime_dir, mode=0o700)
+        os.makedirs(config_dir)
+
+        env = dict(os.environ, XDG_RUNTIME_DIR=runtime_dir, XDG_CONFIG_HOME=config_dir, WAYLAND_DISPLAY="wayland-bench")
+        command = [args.frame, "--platform-display-libs=mir:virtual", "--statistics-socket=bench.sock"]
+        command += [f"--virtual-output={size[0]}x{size[1]}"] * outputs
+        command += args.frame_arg
+
+        log = open(os.path.join(work_dir, "frame.log"), "w")
+        frame = subprocess.Popen(command, env=env, stdout=log, stderr=subprocess.STDOUT)
+        try:
+            display_file = os.path.join(config_dir, "frame.display")
+            wait_for(lambda: os.path.exists(os.path.join(runtime_dir, "wayland-bench")), args.timeout, "frame to start")
+            wait_for(lambda: os.path.exists(display_file), args.timeout, "frame.display")
+
+            names = output_names(display_file)
+            write_layout(display_file, names, size, scale, rotated)
+
+            result = {
+                "outputs": outputs, "resolution": resolution, "scale": scale, "rotated": rotated,
+                "settled": settle(frame.pid, runtime_dir, args.timeout),
+            }
+            result["settled"].update(statistics_of(os.path.join(runtime_dir, "bench.sock")))
+
+            for i in range(args.reconfigurations):
+                write_layout(display_file, names, size, scale, rotated != (i % 2 == 0))
+                time.sleep(args.reconfiguration_interval)
+            if args.reconfigurations % 2:
+                write_layout(display_file, names, size, scale, rotated)
+
+            result["reconfigured"] = settle(frame.pid, runtime_dir, args.timeout)
+            result["reconfigured"].update(statistics_of(os.path.join(runtime_dir, "bench.sock")))
+
+            if frame.poll() is not None:
+                raise RuntimeError(f"frame exited with {frame.returncode}")
+            return result
+        finally:
+            frame.send_signal(signal.SIGTERM)
+            try:
+                frame.wait(timeout=10)
+            except subprocess.TimeoutExpired:
+                frame.kill()
+                frame.wait()
+            log.close()
+
+
+def print_table(results):
+    columns = ["outputs", "resolution", "scale", "rotated"]
+    measures = ["rss", "pss", "anonymous", "shm", "internal_client_shm"]
+    header = columns + [f"{phase[:5]} {m}" for phase in ("settled", "reconfigured") for m in measures]
+    rows = []
+    for result in results:
+        row = [str(result[c]) for c in columns]
+        for phase in ("settled", "reconfigured"):
+            for m in measures:
+                value = result.get(phase, {}).get(m)
+                row.append("-" if value is None else f"{value / 1024:.1f}")
+        rows.append(row)
+
+    widths = [max(len(h), *(len(r[i]) for r in rows)) for i, h in enumerate(header)]
+    print("  ".join(h.rjust(w) for h, w in zip(header, widths)))
+    for row in rows:
+        print("  ".join(v.rjust(w) for v, w in zip(row, widths)))
+    print("(memory in MiB)")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--frame", default="frame", help="The frame executable")
+    parser.add_argument("--outputs", type=lambda t: parse_list(t, int), default=[1, 2, 4, 8, 16])
+    parser.add_argument("--resolutions", type=parse_list, default=list(RESOLUTIONS))
+    parser.add_argument("--scales", type=lambda t: parse_list(t, int), default=[1, 2, 3])
+    parser.add_argument("--rotations", type=lambda t: parse_list(t, lambda r: r == "rotated"), default=[False, True],
+                        help="Comma separated list of 'normal' and 'rotated'")
+    parser.add_argument("--reconfigurations", type=int, default=10)
+    parser.add_argument("--reconfiguration-interval", type=float, default=0.5, help="Seconds between reconfigurations")
+    parser.add_argument("--timeout", type=float, default=30, help="Seconds to wait for startup or settling")
+    parser.add_argument("--json", default="memory_footprint.json", help="Where to write the results")
+    parser.add_argument("--frame-arg", action="append", default=[],
+                        help="Extra option for frame (e.g. --frame-arg=--platform-rendering-libs=mir:egl-generic)")
+    args = parser.parse_args()
+
+    for resolution in args.resolutions:
+        if resolution not in RESOLUTIONS:
+            parser.error(f"Unknown resolution {resolution} (expected one of {', '.join(RESOLUTIONS)})")
+
+    results = []
+    for outputs, resolution, scale, rotated in itertools.product(args.outputs, args.resolutions, args.scales, args.rotations):
+        print(f"{outputs} x {resolution}, scale {scale}{', rotated' if rotated else ''}...", file=sys.stderr)
+        try:
+            results.append(measure(args, outputs, resolution, scale, rotated))
+        except RuntimeError as error:
+            print(f"  failed: {error}", file=sys.stderr)
+            results.append({"outputs": outputs, "resolution": resolution, "scale": scale, "rotated": rotated,
+                            "error": str(error)})
+
+    print_table(results)
+    with open(args.json, "w") as output:
+        json.dump({"units": "kB", "results": results}, output, indent=2)
+
+    return 0 if all("error" not in result for result in results) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,512 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Replays a window management trace recorded with wm-trace-file into frame running headless on Mir's virtual
+// platform, so that FrameWindowManagerPolicy handles the same window inputs again. Frame can be run under a
+// profiler (--profiler), and record a trace of the replay (--record) to compare with the original in
+// wm-trace-report.
+//
+// The traced applications are played by Wayland clients, one connection per traced pid, using wl_shell as frame's
+// internal clients do. The outputs are the ones the trace starts with. What a wl_shell client can't ask for (moves,
+// minimizing and hiding), windows whose parents aren't traced (menus, tips and the like), application zones and
+// later output changes are counted and skipped.
+
+#include "frame_trace_format.h"
+
+#include <mir_toolkit/common.h>
+#include <wayland-client.h>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using frame_trace::Event;
+using frame_trace::Record;
+using namespace std::chrono;
+
+namespace
+{
+auto constexpr unset = INT32_MIN;
+
+struct Entry
+{
+    Record record;
+    std::vector<int32_t> values;
+
+    auto value(size_t i) const -> int32_t { return i < values.size() ? values[i] : unset; }
+};
+
+auto read_trace(char const* path, std::vector<Entry>& entries) -> bool
+{
+    std::ifstream in{path, std::ios::binary};
+    char magic[sizeof frame_trace::magic];
+    if (!in.read(magic, sizeof magic) || memcmp(magic, frame_trace::magic, sizeof magic) != 0)
+    {
+        fprintf(stderr, "%s is not a window management trace\n", path);
+        return false;
+    }
+
+    Entry entry;
+    while (in.read(reinterpret_cast<char*>(&entry.record), sizeof entry.record))
+    {
+        entry.values.resize(entry.record.value_count);
+        if (!in.read(reinterpret_cast<char*>(entry.values.data()), entry.values.size()*sizeof(int32_t)))
+        {
+            fprintf(stderr, "Trace truncated, replaying what was recorded\n");
+            break;
+        }
+
+        entries.push_back(entry);
+    }
+
+    return true;
+}
+
+// A traced application
+struct Connection
+{
+    wl_display* display = nullptr;
+    wl_compositor* compositor = nullptr;
+    wl_shm* shm = nullptr;
+    wl_shell* shell = nullptr;
+
+    static void global(void* data, wl_registry* registry, uint32_t name, char const* interface, uint32_t)
+    {
+        auto const self = static_cast<Connection*>(data);
+
+        auto const bind = [&](wl_interface const& wanted) { return wl_registry_bind(registry, name, &wanted, 1); };
+
+        if (strcmp(interface, wl_compositor_interface.name) == 0)
+            self->compositor = static_cast<wl_compositor*>(bind(wl_compositor_interface));
+        else if (strcmp(interface, wl_shm_interface.name) == 0)
+            self->shm = static_cast<wl_shm*>(bind(wl_shm_interface));
+        else if (strcmp(interface, wl_shell_interface.name) == 0)
+            self->shell = static_cast<wl_shell*>(bind(wl_shell_interface));
+    }
+
+    static void global_remove(void*, wl_registry*, uint32_t) {}
+
+    static constexpr wl_registry_listener registry_listener{&global, &global_remove};
+
+    auto connect() -> bool
+    {
+        display = wl_display_connect(nullptr);
+        if (!display)
+            return false;
+
+        auto const registry = wl_display_get_registry(display);
+        wl_registry_add_listener(registry, &registry_listener, this);
+        wl_display_roundtrip(display);
+        wl_registry_destroy(registry);
+
+        return compositor && shm && shell;
+    }
+
+    ~Connection()
+    {
+        if (shell) wl_shell_destroy(shell);
+        if (shm) wl_shm_destroy(shm);
+        if (compositor) wl_compositor_destroy(compositor);
+        if (display) wl_display_disconnect(display);
+    }
+};
+
+// A traced window
+struct Window
+{
+    Connection& connection;
+    wl_surface* surface = nullptr;
+    wl_shell_surface* shell_surface = nullptr;
+    wl_buffer* buffer = nullptr;
+
+    static void ping(void*, wl_shell_surface* shell_surface, uint32_t serial)
+    {
+        wl_shell_surface_pong(shell_surface, serial);
+    }
+
+    // The window manager's sizes are what we're measuring, so we don't follow them with new buffers
+    static void configure(void*, wl_shell_surface*, uint32_t, int32_t, int32_t) {}
+    static void popup_done(void*, wl_shell_surface*) {}
+
+    static constexpr wl_shell_surface_listener shell_surface_listener{&ping, &configure, &popup_done};
+
+    explicit Window(Connection& connection) :
+        connection{connection},
+        surface{wl_compositor_create_surface(connection.compositor)},
+        shell_surface{wl_shell_get_shell_surface(connection.shell, surface)}
+    {
+        wl_shell_surface_add_listener(shell_surface, &shell_surface_listener, this);
+    }
+
+    ~Window()
+    {
+        if (buffer) wl_buffer_destroy(buffer);
+        wl_shell_surface_destroy(shell_surface);
+        wl_surface_destroy(surface);
+    }
+
+    // Returns false for states a wl_shell client can't request
+    auto set_state(int32_t state) -> bool
+    {
+        switch (state)
+        {
+        case mir_window_state_fullscreen:
+            wl_shell_surface_set_fullscreen(shell_surface, WL_SHELL_SURFACE_FULLSCREEN_METHOD_DEFAULT, 0, nullptr);
+            return true;
+
+        case mir_window_state_maximized:
+        case mir_window_state_vertmaximized:
+        case mir_window_state_horizmaximized:
+            wl_shell_surface_set_maximized(shell_surface, nullptr);
+            return true;
+
+        case unset:
+        case mir_window_state_unknown:
+        case mir_window_state_restored:
+            wl_shell_surface_set_toplevel(shell_surface);
+            return true;
+
+        default:
+            return false;
+        }
+    }
+
+    // The contents don't matter, only the size
+    void attach(int32_t width, int32_t height)
+    {
+        width = std::max(width, 1);
+        height = std::max(height, 1);
+        auto const size = size_t(width)*height*4;
+
+        auto const fd = memfd_create("wm-trace-replay", MFD_CLOEXEC);
+        if (fd < 0 || ftruncate(fd, size) != 0)
+        {
+            if (fd >= 0) close(fd);
+            return;
+        }
+
+        auto const pool = wl_shm_create_pool(connection.shm, fd, size);
+        if (buffer) wl_buffer_destroy(buffer);
+        buffer = wl_shm_pool_create_buffer(pool, 0, width, height, width*4, WL_SHM_FORMAT_XRGB8888);
+        wl_shm_pool_destroy(pool);
+        close(fd);
+
+        wl_surface_attach(surface, buffer, 0, 0);
+        wl_surface_damage(surface, 0, 0, width, height);
+        wl_surface_commit(surface);
+    }
+};
+
+// Inputs in the trace that can't be replayed, by reason
+struct Skipped
+{
+    std::map<std::string, size_t> reasons;
+
+    void operator()(char const* reason) { ++reasons[reason]; }
+};
+
+auto wait_for(std::filesystem::path const& path, pid_t frame) -> bool
+{
+    for (auto const deadline = steady_clock::now() + seconds{30}; steady_clock::now() < deadline;)
+    {
+        if (std::filesystem::exists(path))
+            return true;
+
+        if (waitpid(frame, nullptr, WNOHANG) == frame)
+            return false;
+
+        std::this_thread::sleep_for(milliseconds{50});
+    }
+
+    return false;
+}
+
+auto split(std::string const& command) -> std::vector<std::string>
+{
+    std::vector<std::string> words;
+    std::istringstream in{command};
+    for (std::string word; in >> word;)
+        words.push_back(word);
+    return words;
+}
+}
+
+int main(int argc, char const* argv[])
+{
+    bool fast = false;
+    std::string frame = "frame";
+    std::string profiler;
+    std::string record;
+    char const* path = nullptr;
+
+    for (auto arg = argv + 1; arg != argv + argc; ++arg)
+    {
+        if (strcmp(*arg, "--fast") == 0)
+            fast = true;
+        else if (strncmp(*arg, "--frame=", 8) == 0)
+            frame = *arg + 8;
+        else if (strncmp(*arg, "--profiler=", 11) == 0)
+            profiler = *arg + 11;
+        else if (strncmp(*arg, "--record=", 9) == 0)
+            record = *arg + 9;
+        else
+            path = *arg;
+    }
+
+    if (!path)
+    {
+        fprintf(stderr,
+            "Usage: %s [--fast] [--frame=<frame>] [--profiler=<command>] [--record=<trace file>] <trace file>\n"
+            "  --fast      don't wait between inputs as the original did\n"
+            "  --profiler  run frame under this command (e.g. --profiler=\"perf record -g -o frame.perf\")\n"
+            "  --record    record the replay to this trace file (for wm-trace-report)\n",
+            argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Entry> entries;
+    if (!read_trace(path, entries))
+        return EXIT_FAILURE;
+
+    // The virtual platform's outputs are the ones the trace starts with
+    std::vector<std::string> outputs;
+    for (auto const& entry : entries)
+    {
+        if (entry.record.event != Event::output_create)
+            break;
+
+        outputs.push_back(std::to_string(entry.value(2)) + "x" + std::to_string(entry.value(3)));
+    }
+    auto const initial_outputs = outputs.size();
+
+    if (outputs.empty())
+        outputs.push_back("1920x1080");
+
+    // A runtime and config directory of our own, so neither the socket nor the display layout clash with a session
+    char directory_template[] = "/tmp/wm-trace-replay-XXXXXX";
+    if (!mkdtemp(directory_template))
+    {
+        perror("Failed to create a runtime directory");
+        return EXIT_FAILURE;
+    }
+
+    std::filesystem::path const directory{directory_template};
+    setenv("XDG_RUNTIME_DIR", directory.c_str(), 1);
+    setenv("XDG_CONFIG_HOME", directory.c_str(), 1);
+    setenv("WAYLAND_DISPLAY", "wayland-replay", 1);
+
+    auto command = split(profiler);
+    command.push_back(frame);
+    command.push_back("--platform-display-libs=mir:virtual");
+    for (auto const& output : outputs)
+        command.push_back("--virtual-output=" + output);
+    if (!record.empty())
+        command.push_back("--wm-trace-file=" + std::filesystem::absolute(record).string());
+
+    auto const frame_pid = fork();
+    if (frame_pid == 0)
+    {
+        std::vector<char*> args;
+        for (auto& word : command)
+            args.push_back(word.data());
+        args.push_back(nullptr);
+
+        execvp(args[0], args.data());
+        perror(args[0]);
+        _exit(EXIT_FAILURE);
+    }
+
+    if (frame_pid < 0 || !wait_for(directory/"wayland-replay", frame_pid))
+    {
+        fprintf(stderr, "Failed to start %s\n", frame.c_str());
+        std::filesystem::remove_all(directory);
+        return EXIT_FAILURE;
+    }
+
+    std::map<int32_t, std::unique_ptr<Connection>> connections;
+    std::map<uint32_t, std::unique_ptr<Window>> windows;
+    std::map<int32_t, Entry const*> placing;    // The last placement requested by each pid
+    Skipped skipped;
+    size_t replayed = 0;
+
+    auto const connection_for = [&](int32_t pid) -> Connection*
+        {
+            auto& connection = connections[pid];
+            if (!connection)
+            {
+                connection = std::make_unique<Connection>();
+                if (!connection->connect())
+                {
+                    fprintf(stderr, "Failed to connect to frame as traced pid %d\n", pid);
+                    connection.reset();
+                }
+            }
+            return connection.get();
+        };
+
+    auto const started = steady_clock::now();
+    auto due = started;
+
+    for (auto const& entry : entries)
+    {
+        if (!fast)
+        {
+            due += microseconds{entry.record.since_previous_us};
+            std::this_thread::sleep_until(due);
+        }
+
+        Connection* used = nullptr;
+
+        switch (entry.record.event)
+        {
+        case Event::place_window:
+            placing[entry.value(0)] = &entry;
+            continue;
+
+        case Event::new_window:
+        {
+            auto const type = entry.value(1);
+            if (type != mir_window_type_normal && type != mir_window_type_utility &&
+                type != mir_window_type_dialog && type != mir_window_type_freestyle)
+            {
+                skipped("windows with untraced parents");
+                continue;
+            }
+
+            auto const connection = connection_for(entry.value(0));
+            if (!connection)
+                continue;
+
+            // Ask for the state the client asked for, not the one the policy chose
+            auto state = entry.value(2);
+            if (auto const request = placing.find(entry.value(0)); request != placing.end())
+            {
+                state = request->second->value(2);
+                placing.erase(request);
+            }
+
+            auto window = std::make_unique<Window>(*connection);
+            if (!window->set_state(state))
+            {
+                skipped("states wl_shell can't request");
+                window->set_state(unset);
+            }
+            window->attach(entry.value(5), entry.value(6));
+            windows[entry.record.object] = std::move(window);
+            used = connection;
+            break;
+        }
+
+        case Event::modify_window:
+        {
+            auto const window = windows.find(entry.record.object);
+            if (window == windows.end())
+                continue;
+
+            auto const state = entry.value(0);
+            if (state != unset)
+            {
+                if (!window->second->set_state(state))
+                    skipped("states wl_shell can't request");
+            }
+            else if (entry.value(3) != unset)
+            {
+                window->second->attach(entry.value(3), entry.value(4));
+            }
+            else
+            {
+                skipped("moves");
+            }
+
+            used = &window->second->connection;
+            break;
+        }
+
+        case Event::delete_window:
+        {
+            auto const window = windows.find(entry.record.object);
+            if (window == windows.end())
+                continue;
+
+            used = &window->second->connection;
+            windows.erase(window);
+            break;
+        }
+
+        case Event::zone_create:
+        case Event::zone_update:
+        case Event::zone_delete:
+            skipped("application zone changes");
+            continue;
+
+        case Event::output_create:
+        case Event::output_update:
+        case Event::output_delete:
+            if (size_t(&entry - entries.data()) >= initial_outputs)
+                skipped("output changes");
+            continue;
+
+        case Event::end_of_transaction:
+            continue;
+        }
+
+        // Wait for frame to handle each input, so the inputs of different applications arrive in the traced order
+        if (used)
+        {
+            wl_display_roundtrip(used->display);
+            ++replayed;
+        }
+    }
+
+    auto const elapsed = duration<double>(steady_clock::now() - started).count();
+
+    windows.clear();
+    for (auto const& [pid, connection] : connections)
+    {
+        if (connection)
+            wl_display_roundtrip(connection->display);
+    }
+    connections.clear();
+
+    kill(frame_pid, SIGTERM);
+    waitpid(frame_pid, nullptr, 0);
+    std::filesystem::remove_all(directory);
+
+    printf("Replayed %zu window inputs into %zu output(s) in %.3fs\n", replayed, outputs.size(), elapsed);
+    for (auto const& [reason, count] : skipped.reasons)
+        printf("Skipped %zu %s\n", count, reason.c_str());
+
+    if (!record.empty())
+        printf("The replay was recorded to %s (summarize it with wm-trace-report)\n", record.c_str());
+
+    return EXIT_SUCCESS;
+}
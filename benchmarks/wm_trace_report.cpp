@@ -0,0 +1,156 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Summarizes a window management trace recorded with wm-trace-file: how long the policy took in each hook, and how
+// bursty its inputs were. With --dump it also prints every record.
+
+#include "frame_trace_format.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <numeric>
+#include <string>
+#include <vector>
+
+using frame_trace::Event;
+using frame_trace::Record;
+
+namespace
+{
+auto name_of(Event event) -> char const*
+{
+    switch (event)
+    {
+    case Event::place_window:       return "place_new_window";
+    case Event::new_window:         return "advise_new_window";
+    case Event::modify_window:      return "handle_modify_window";
+    case Event::delete_window:      return "advise_delete_window";
+    case Event::zone_create:        return "advise_zone_create";
+    case Event::zone_update:        return "advise_zone_update";
+    case Event::zone_delete:        return "advise_zone_delete";
+    case Event::output_create:      return "advise_output_create";
+    case Event::output_update:      return "advise_output_update";
+    case Event::output_delete:      return "advise_output_delete";
+    case Event::end_of_transaction: return "advise_end";
+    }
+
+    return "unknown";
+}
+
+struct Hook
+{
+    std::vector<double> us;
+
+    void print(char const* name)
+    {
+        std::sort(begin(us), end(us));
+        auto const mean = std::accumulate(begin(us), end(us), 0.0)/us.size();
+        printf("%-24s %8zu %9.2f %9.2f %9.2f %9.2f\n",
+            name, us.size(), mean, us[us.size()/2], us[us.size()*99/100], us.back());
+    }
+};
+}
+
+int main(int argc, char const* argv[])
+{
+    bool dump = false;
+    char const* path = nullptr;
+
+    for (auto arg = argv + 1; arg != argv + argc; ++arg)
+    {
+        if (strcmp(*arg, "--dump") == 0)
+            dump = true;
+        else
+            path = *arg;
+    }
+
+    if (!path)
+    {
+        fprintf(stderr, "Usage: %s [--dump] <trace file>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream in{path, std::ios::binary};
+    char magic[sizeof frame_trace::magic];
+    if (!in.read(magic, sizeof magic) || memcmp(magic, frame_trace::magic, sizeof magic) != 0)
+    {
+        fprintf(stderr, "%s is not a window management trace\n", path);
+        return EXIT_FAILURE;
+    }
+
+    std::map<Event, Hook> hooks;
+    std::deque<uint64_t> last_second;   // Start times (us) of the records in the last second
+    size_t peak_per_second = 0;
+    uint64_t now_us = 0;
+    uint64_t dropped_modifies = 0;
+
+    Record record;
+    while (in.read(reinterpret_cast<char*>(&record), sizeof record))
+    {
+        std::vector<int32_t> values(record.value_count);
+        if (!in.read(reinterpret_cast<char*>(values.data()), values.size()*sizeof(int32_t)))
+        {
+            fprintf(stderr, "Trace truncated\n");
+            break;
+        }
+
+        now_us += record.since_previous_us;
+        hooks[record.event].us.push_back(record.handled_ns/1000.0);
+
+        if (record.event == Event::modify_window && values.size() > 5 && values[5])
+            ++dropped_modifies;
+
+        // advise_end follows every transaction, so only count the inputs
+        if (record.event != Event::end_of_transaction)
+        {
+            last_second.push_back(now_us);
+            while (last_second.front() + 1000000 <= now_us)
+                last_second.pop_front();
+            peak_per_second = std::max(peak_per_second, last_second.size());
+        }
+
+        if (dump)
+        {
+            printf("%12.6f %-22s %6" PRIu32 " %8.2fus", now_us/1e6, name_of(record.event), record.object,
+                record.handled_ns/1000.0);
+            for (auto value : values)
+            {
+                if (value == INT32_MIN)
+                    printf(" -");
+                else
+                    printf(" %" PRId32, value);
+            }
+            printf("\n");
+        }
+    }
+
+    printf("%-24s %8s %9s %9s %9s %9s\n", "hook (time handling)", "count", "mean us", "p50 us", "p99 us", "max us");
+    for (auto& [event, hook] : hooks)
+    {
+        hook.print(name_of(event));
+    }
+
+    printf("%.1f seconds, peak of %zu inputs in a second, %" PRIu64 " repeated modify requests dropped\n",
+        now_us/1e6, peak_per_second, dropped_modifies);
+
+    return EXIT_SUCCESS;
+}
@@ -26,10 +26,24 @@
 #include <sys/eventfd.h>
 #include <sys/mman.h>
 #include <sys/poll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <algorithm>
 #include <cstdlib>
 
 #include <cstring>
 #include <system_error>
+#include <utility>
+
+namespace
+{
+egmde::FullscreenClient::Reports reports;
+}
+
+void egmde::FullscreenClient::report_to(Reports reports)
+{
+    ::reports = std::move(reports);
+}
 
 void egmde::FullscreenClient::Output::geometry(
     void* data,
@@ -57,7 +71,7 @@ void egmde::FullscreenClient::Output::mode(
     uint32_t flags,
     int32_t width,
     int32_t height,
-    int32_t /*refresh*/)
+    int32_t refresh)
 {
     if (!(WL_OUTPUT_MODE_CURRENT & flags))
         return;
@@ -66,6 +80,7 @@ void egmde::FullscreenClient::Output::mode(
 
     output->width = width,
     output->height = height;
+    output->refresh_mhz = refresh;
 }
 
 void egmde::FullscreenClient::Output::scale(void* data, wl_output* /*wl_output*/, int32_t factor)
@@ -78,10 +93,10 @@ void egmde::FullscreenClient::Output::scale(void* data, wl_output* /*wl_output*/
 egmde::FullscreenClient::Output::Output(
     wl_output* output,
     std::function<void(Output const&)> on_constructed,
-    std::function<void(Output const&)> on_change)
+    std::function<void(Output const&, Change)> on_change)
     : output{output},
       on_done{[this, on_constructed = std::move(on_constructed), on_change=std::move(on_change)]
-      (Output const& o) mutable { on_constructed(o), on_done = std::move(on_change); }}
+      (Output const& o, Change) mutable { on_constructed(o), on_done = std::move(on_change); }}
 {
     wl_output_add_listener(output, &output_listener, this);
 }
@@ -130,12 +145,37 @@ void egmde::FullscreenClient::SurfaceInfo::clear_window()
 void egmde::FullscreenClient::Output::done(void* data, struct wl_output* /*wl_output*/)
 {
     auto output = static_cast<Output*>(data);
-    output->on_done(*output);
+    auto const change = output->update_last_done();
+    output->on_done(*output, change);
 }
 
-egmde::FullscreenClient::FullscreenClient(wl_display* display) :
+auto egmde::FullscreenClient::Output::update_last_done() -> Change
+{
+    State const current{x, y, width, height, transform, scale_factor};
+    auto const previous = std::exchange(last_done, current);
+
+    // Mir resends the output state for display configuration changes elsewhere, and refresh rate alone
+    // doesn't affect what we draw
+    if (current.width != previous.width || current.height != previous.height ||
+        current.transform != previous.transform || current.scale_factor != previous.scale_factor)
+    {
+        return Change::content;
+    }
+
+    if (current.x != previous.x || current.y != previous.y)
+    {
+        return Change::position;
+    }
+
+    return Change::none;
+}
+
+egmde::FullscreenClient::FullscreenClient(wl_display* display, FullscreenClient* host) :
+    host{host},
     flush_signal{::eventfd(0, EFD_SEMAPHORE)},
     shutdown_signal{::eventfd(0, EFD_CLOEXEC)},
+    work_signal{::eventfd(0, EFD_CLOEXEC)},
+    tick_timer{::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC)},
     registry{nullptr, [](auto){}}
 {
     if (shutdown_signal == mir::Fd::invalid)
@@ -143,8 +183,28 @@ egmde::FullscreenClient::FullscreenClient(wl_display* display) :
         BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to create shutdown notifier"}));
     }
 
+    if (work_signal == mir::Fd::invalid)
+    {
+        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to create work notifier"}));
+    }
+
+    if (tick_timer == mir::Fd::invalid)
+    {
+        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to create tick timer"}));
+    }
+
     this->display = display;
 
+    if (host)
+    {
+        // The host has bound the globals and tracks the outputs for us
+        compositor = host->compositor;
+        shell = host->shell;
+        shm = host->shm;
+        shm_formats = host->shm_formats;
+        return;
+    }
+
     registry = {wl_display_get_registry(display), &wl_registry_destroy};
 
     static wl_registry_listener const registry_listener = {
@@ -155,20 +215,34 @@ egmde::FullscreenClient::FullscreenClient(wl_display* display) :
     wl_registry_add_listener(registry.get(), &registry_listener, this);
 }
 
-void egmde::FullscreenClient::on_output_changed(Output const* output)
+void egmde::FullscreenClient::on_output_changed(Output const* output, Output::Change change)
 {
+    if (change == Output::Change::none)
+    {
+        if (reports.output_change_ignored)
+            reports.output_change_ignored();
+        return;
+    }
+
     {
         std::lock_guard<decltype(outputs_mutex)> lock{outputs_mutex};
         auto const p = outputs.find(output);
         if (p != end(outputs))
         {
-            if (auto& buffer = p->second.buffer)
+            if (change == Output::Change::position)
             {
-                wl_buffer_destroy(buffer);
-                buffer = nullptr;
+                output_moved(p->second);
             }
+            else
+            {
+                if (auto& buffer = p->second.buffer)
+                {
+                    wl_buffer_destroy(buffer);
+                    buffer = nullptr;
+                }
 
-            draw_screen(p->second);
+                draw_screen(p->second);
+            }
         }
 
         auto i = begin(hidden_outputs);
@@ -190,6 +264,49 @@ void egmde::FullscreenClient::on_output_changed(Output const* output)
         {
             hidden_outputs.erase(i);
         }
+
+        on_outputs_updated(outputs.size(), hidden_outputs.size());
+    }
+
+    for (auto const guest : guests)
+    {
+        guest->on_output_changed(output, change);
+    }
+    wl_display_flush(display);
+}
+
+void egmde::FullscreenClient::for_each_output(std::function<void(Output const&)> const& f) const
+{
+    std::lock_guard<decltype(outputs_mutex)> lock{outputs_mutex};
+    for (auto const& output : outputs)
+    {
+        f(*output.first);
+    }
+}
+
+auto egmde::FullscreenClient::display_extents() const -> mir::geometry::Rectangle
+{
+    mir::geometry::Rectangles extents;
+    for (auto const& output : outputs)
+    {
+        auto const& o = *output.first;
+        bool const rotated = o.transform & WL_OUTPUT_TRANSFORM_90;
+        extents.add({
+            {o.x*o.scale_factor, o.y*o.scale_factor},
+            {rotated ? o.height : o.width, rotated ? o.width : o.height}});
+    }
+
+    return extents.bounding_rectangle();
+}
+
+void egmde::FullscreenClient::redraw()
+{
+    {
+        std::lock_guard<decltype(outputs_mutex)> lock{outputs_mutex};
+        for (auto& output : outputs)
+        {
+            draw_screen(output.second);
+        }
     }
     wl_display_flush(display);
 }
@@ -240,6 +357,13 @@ void egmde::FullscreenClient::on_output_gone(Output const* output)
         {
             hidden_outputs.erase(i);
         }
+
+        on_outputs_updated(outputs.size(), hidden_outputs.size());
+    }
+
+    for (auto const guest : guests)
+    {
+        guest->on_output_gone(output);
     }
     wl_display_flush(display);
 }
@@ -262,10 +386,54 @@ void egmde::FullscreenClient::on_new_output(Output const* output)
         {
             hidden_outputs.emplace_back(output);
         }
+
+        on_outputs_updated(outputs.size(), hidden_outputs.size());
+    }
+
+    for (auto const guest : guests)
+    {
+        guest->on_new_output(output);
     }
     wl_display_flush(display);
 }
 
+void egmde::FullscreenClient::add_guest(FullscreenClient& guest)
+{
+    guests.push_back(&guest);
+    update_input_devices();
+
+    // Tell the guest about the outputs we already know
+    std::vector<Output const*> known;
+    {
+        std::lock_guard<decltype(outputs_mutex)> lock{outputs_mutex};
+        for (auto const& output : outputs)
+            known.push_back(output.first);
+        known.insert(end(known), begin(hidden_outputs), end(hidden_outputs));
+    }
+
+    for (auto const output : known)
+    {
+        guest.on_new_output(output);
+    }
+}
+
+auto egmde::FullscreenClient::owns(wl_surface* surface) const -> bool
+{
+    std::lock_guard<decltype(outputs_mutex)> lock{outputs_mutex};
+    return std::any_of(begin(outputs), end(outputs), [surface](auto const& output) { return output.second.surface == surface; });
+}
+
+auto egmde::FullscreenClient::client_for(wl_surface* surface) -> FullscreenClient*
+{
+    for (auto const guest : guests)
+    {
+        if (guest->owns(surface))
+            return guest;
+    }
+
+    return this;
+}
+
 auto egmde::FullscreenClient::make_shm_pool(size_t size, void** data) const
 -> std::unique_ptr<wl_shm_pool, std::function<void(wl_shm_pool*)>>
 {
@@ -306,17 +474,45 @@ auto egmde::FullscreenClient::make_shm_pool(size_t size, void** data) const
         BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to mmap buffer"}));
     }
 
-    return {
-        wl_shm_create_pool(shm, fd, size),
-        [size](auto* shm)
-        {
-            wl_shm_pool_destroy(shm);
-            munmap(shm, size);
-        }};
+    if (reports.shm_mapped)
+        reports.shm_mapped(size);
+
+    return {wl_shm_create_pool(shm, fd, size), &wl_shm_pool_destroy};
+}
+
+auto egmde::FullscreenClient::shm_pool_from(int fd, size_t size) const
+-> std::unique_ptr<wl_shm_pool, std::function<void(wl_shm_pool*)>>
+{
+    return {wl_shm_create_pool(shm, fd, size), &wl_shm_pool_destroy};
+}
+
+auto egmde::FullscreenClient::supports_shm_format(uint32_t format) const -> bool
+{
+    return std::find(begin(shm_formats), end(shm_formats), format) != end(shm_formats);
+}
+
+void egmde::FullscreenClient::unmap_shm(void* data, size_t size)
+{
+    if (data && munmap(data, size) == 0 && reports.shm_mapped)
+    {
+        reports.shm_mapped(-std::ptrdiff_t(size));
+    }
 }
 
 egmde::FullscreenClient::~FullscreenClient()
 {
+    if (host)
+    {
+        auto& siblings = host->guests;
+        siblings.erase(std::remove(begin(siblings), end(siblings), this), end(siblings));
+
+        for (auto focus : {&host->keyboard_focus, &host->pointer_focus, &host->touch_focus})
+        {
+            if (*focus == this)
+                *focus = host;
+        }
+    }
+
     {
         std::lock_guard<decltype(outputs_mutex)> lock{outputs_mutex};
         outputs.clear();
@@ -338,8 +534,12 @@ void egmde::FullscreenClient::new_global(struct wl_registry* registry, uint32_t
     else if (strcmp(interface, "wl_shm") == 0)
     {
         shm = static_cast<decltype(shm)>(wl_registry_bind(registry, id, &wl_shm_interface, 1));
-        // Normally we'd add a listener to pick up the supported formats here
-        // As luck would have it, I know that argb8888 is the only format we support :)
+        static wl_shm_listener const shm_listener =
+            {
+                [](void* self, wl_shm*, uint32_t format) { static_cast<FullscreenClient*>(self)->shm_formats.push_back(format); },
+            };
+
+        wl_shm_add_listener(shm, &shm_listener, this);
     }
     else if (strcmp(interface, "wl_seat") == 0)
     {
@@ -363,7 +563,7 @@ void egmde::FullscreenClient::new_global(struct wl_registry* registry, uint32_t
                 std::make_unique<Output>(
                     output,
                     [this](Output const& output) { on_new_output(&output); },
-                    [this](Output const& output) { on_output_changed(&output); })));
+                    [this](Output const& output, Output::Change change) { on_output_changed(&output, change); })));
     }
     else if (strcmp(interface, "wl_shell") == 0)
     {
@@ -388,18 +588,33 @@ void egmde::FullscreenClient::run(wl_display* display)
 {
     enum FdIndices {
         display_fd = 0,
-        flush,
         shutdown,
-        indices
+        client_fds
     };
 
-    pollfd fds[indices] =
-        {
+    // Each client (this and any guests) has a flush, work and tick fd
+    enum ClientFdIndices {
+        flush,
+        work,
+        tick,
+        fds_per_client
+    };
+
+    std::vector<FullscreenClient*> clients{this};
+    clients.insert(end(clients), begin(guests), end(guests));
+
+    std::vector<pollfd> fds{
             {wl_display_get_fd(display), POLLIN, 0},
-            {flush_signal,               POLLIN, 0},
             {shutdown_signal,            POLLIN, 0},
         };
 
+    for (auto const client : clients)
+    {
+        fds.push_back({client->flush_signal, POLLIN, 0});
+        fds.push_back({client->work_signal,  POLLIN, 0});
+        fds.push_back({client->tick_timer,   POLLIN, 0});
+    }
+
     while (!(fds[shutdown].revents & (POLLIN | POLLERR)))
     {
         while (wl_display_prepare_read(display) != 0)
@@ -410,7 +625,7 @@ void egmde::FullscreenClient::run(wl_display* display)
             }
         }
 
-        if (poll(fds, indices, -1) == -1)
+        if (poll(fds.data(), fds.size(), -1) == -1)
         {
             wl_display_cancel_read(display);
             BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to wait for event"}));
@@ -428,15 +643,90 @@ void egmde::FullscreenClient::run(wl_display* display)
             wl_display_cancel_read(display);
         }
 
-        if (fds[flush].revents & (POLLIN | POLLERR))
+        for (auto i = 0u; i != clients.size(); ++i)
+        {
+            auto const client_fd = &fds[client_fds + i*fds_per_client];
+            clients[i]->handle_signals(client_fd[flush].revents, client_fd[work].revents, client_fd[tick].revents);
+        }
+    }
+}
+
+void egmde::FullscreenClient::handle_signals(short flush_events, short work_events, short tick_events)
+{
+    if (flush_events & (POLLIN | POLLERR))
+    {
+        eventfd_t foo;
+        eventfd_read(flush_signal, &foo);
+        wl_display_flush(display);
+    }
+
+    if (work_events & (POLLIN | POLLERR))
+    {
+        eventfd_t foo;
+        eventfd_read(work_signal, &foo);
+
+        decltype(work_queue) pending;
+        {
+            std::lock_guard<decltype(work_mutex)> lock{work_mutex};
+            std::swap(pending, work_queue);
+        }
+
+        for (auto const& item : pending)
+        {
+            item();
+        }
+
+        wl_display_flush(display);
+    }
+
+    if (tick_events & (POLLIN | POLLERR))
+    {
+        uint64_t expirations;
+        if (read(tick_timer, &expirations, sizeof expirations) == sizeof expirations)
         {
-            eventfd_t foo;
-            eventfd_read(flush_signal, &foo);
+            on_tick();
             wl_display_flush(display);
         }
     }
 }
 
+void egmde::FullscreenClient::set_tick_interval(std::chrono::nanoseconds interval)
+{
+    auto const seconds = std::chrono::duration_cast<std::chrono::seconds>(interval);
+    timespec const period{seconds.count(), (interval - seconds).count()};
+    itimerspec const spec{period, period};
+
+    if (timerfd_settime(tick_timer, 0, &spec, nullptr) == -1)
+    {
+        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to set tick interval"}));
+    }
+}
+
+void egmde::FullscreenClient::on_tick()
+{
+}
+
+void egmde::FullscreenClient::output_moved(SurfaceInfo& /*info*/) const
+{
+}
+
+void egmde::FullscreenClient::on_outputs_updated(size_t /*visible*/, size_t /*hidden*/)
+{
+}
+
+void egmde::FullscreenClient::invoke(std::function<void()> work)
+{
+    {
+        std::lock_guard<decltype(work_mutex)> lock{work_mutex};
+        work_queue.push_back(std::move(work));
+    }
+
+    if (eventfd_write(work_signal, 1) == -1)
+    {
+        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to notify internal client"}));
+    }
+}
+
 void egmde::FullscreenClient::stop()
 {
     if (eventfd_write(shutdown_signal, 1) == -1)
@@ -585,59 +875,143 @@ void egmde::FullscreenClient::touch_orientation(
 {
 }
 
-void egmde::FullscreenClient::seat_capabilities(wl_seat* seat, uint32_t capabilities)
+void egmde::FullscreenClient::seat_capabilities(wl_seat* /*seat*/, uint32_t capabilities)
+{
+    seat_caps = capabilities;
+    update_input_devices();
+}
+
+auto egmde::FullscreenClient::input_capabilities() const -> uint32_t
 {
-    if (capabilities & WL_SEAT_CAPABILITY_POINTER) {
+    return 0;
+}
+
+void egmde::FullscreenClient::update_input_devices()
+{
+    if (!seat)
+        return;
+
+    auto wanted = input_capabilities();
+    for (auto const guest : guests)
+    {
+        wanted |= guest->input_capabilities();
+    }
+    wanted &= seat_caps;
+
+    // Events for a surface go to the client (this or a guest) that owns it, and following events without a surface
+    // go to the same client
+    if (!(wanted & WL_SEAT_CAPABILITY_POINTER) && pointer)
+    {
+        wl_pointer_release(pointer);
+        pointer = nullptr;
+    }
+    else if ((wanted & WL_SEAT_CAPABILITY_POINTER) && !pointer)
+    {
         static wl_pointer_listener pointer_listener =
             {
-                [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->pointer_enter(args...); },
-                [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->pointer_leave(args...); },
-                [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->pointer_motion(args...); },
-                [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->pointer_button(args...); },
-                [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->pointer_axis(args...); },
-                [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->pointer_frame(args...); },
-                [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->pointer_axis_source(args...); },
-                [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->pointer_axis_stop(args...); },
-                [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->pointer_axis_discrete(args...); },
+                [](void* self, wl_pointer* pointer, uint32_t serial, wl_surface* surface, wl_fixed_t x, wl_fixed_t y)
+                {
+                    auto const host = static_cast<FullscreenClient*>(self);
+                    host->pointer_focus = host->client_for(surface);
+                    host->pointer_focus->pointer_enter(pointer, serial, surface, x, y);
+                },
+                [](void* self, wl_pointer* pointer, uint32_t serial, wl_surface* surface)
+                {
+                    auto const host = static_cast<FullscreenClient*>(self);
+                    host->client_for(surface)->pointer_leave(pointer, serial, surface);
+                    host->pointer_focus = host;
+                },
+                [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->pointer_focus->pointer_motion(args...); },
+                [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->pointer_focus->pointer_button(args...); },
+                [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->pointer_focus->pointer_axis(args...); },
+                [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->pointer_focus->pointer_frame(args...); },
+                [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->pointer_focus->pointer_axis_source(args...); },
+                [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->pointer_focus->pointer_axis_stop(args...); },
+                [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->pointer_focus->pointer_axis_discrete(args...); },
             };
 
-        struct wl_pointer *pointer = wl_seat_get_pointer(seat);
-        wl_pointer_add_listener (pointer, &pointer_listener, this);
+        pointer = wl_seat_get_pointer(seat);
+        wl_pointer_add_listener(pointer, &pointer_listener, this);
     }
 
-    if (capabilities & WL_SEAT_CAPABILITY_KEYBOARD)
+    if (!(wanted & WL_SEAT_CAPABILITY_KEYBOARD) && keyboard)
+    {
+        wl_keyboard_release(keyboard);
+        keyboard = nullptr;
+    }
+    else if ((wanted & WL_SEAT_CAPABILITY_KEYBOARD) && !keyboard)
     {
         static struct wl_keyboard_listener keyboard_listener =
             {
-                [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->keyboard_keymap(args...); },
-                [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->keyboard_enter(args...); },
-                [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->keyboard_leave(args...); },
-                [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->keyboard_key(args...); },
-                [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->keyboard_modifiers(args...); },
-                [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->keyboard_repeat_info(args...); },
+                [](void* self, wl_keyboard* keyboard, uint32_t format, int32_t fd, uint32_t size)
+                {
+                    // Every client may need the keymap, and each is responsible for its own fd
+                    auto const host = static_cast<FullscreenClient*>(self);
+                    for (auto const guest : host->guests)
+                    {
+                        if (guest->input_capabilities() & WL_SEAT_CAPABILITY_KEYBOARD)
+                            guest->keyboard_keymap(keyboard, format, fcntl(fd, F_DUPFD_CLOEXEC, 0), size);
+                    }
+                    host->keyboard_keymap(keyboard, format, fd, size);
+                },
+                [](void* self, wl_keyboard* keyboard, uint32_t serial, wl_surface* surface, wl_array* keys)
+                {
+                    auto const host = static_cast<FullscreenClient*>(self);
+                    host->keyboard_focus = host->client_for(surface);
+                    host->keyboard_focus->keyboard_enter(keyboard, serial, surface, keys);
+                },
+                [](void* self, wl_keyboard* keyboard, uint32_t serial, wl_surface* surface)
+                {
+                    auto const host = static_cast<FullscreenClient*>(self);
+                    host->client_for(surface)->keyboard_leave(keyboard, serial, surface);
+                    host->keyboard_focus = host;
+                },
+                [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->keyboard_focus->keyboard_key(args...); },
+                [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->keyboard_focus->keyboard_modifiers(args...); },
+                [](void* self, wl_keyboard* keyboard, int32_t rate, int32_t delay)
+                {
+                    auto const host = static_cast<FullscreenClient*>(self);
+                    for (auto const guest : host->guests)
+                    {
+                        guest->keyboard_repeat_info(keyboard, rate, delay);
+                    }
+                    host->keyboard_repeat_info(keyboard, rate, delay);
+                },
             };
 
-        wl_keyboard_add_listener(wl_seat_get_keyboard(seat), &keyboard_listener, this);
+        keyboard = wl_seat_get_keyboard(seat);
+        wl_keyboard_add_listener(keyboard, &keyboard_listener, this);
     }
 
-    if (capabilities & WL_SEAT_CAPABILITY_TOUCH)
+    if (!(wanted & WL_SEAT_CAPABILITY_TOUCH) && touch)
+    {
+        wl_touch_release(touch);
+        touch = nullptr;
+    }
+    else if ((wanted & WL_SEAT_CAPABILITY_TOUCH) && !touch)
     {
         static struct wl_touch_listener touch_listener =
         {
-            [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->touch_down(args...); },
-            [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->touch_up(args...); },
-            [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->touch_motion(args...); },
-            [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->touch_frame(args...); },
-            [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->touch_cancel(args...); },
+            [](void* self, wl_touch* touch, uint32_t serial, uint32_t time, wl_surface* surface, int32_t id, wl_fixed_t x, wl_fixed_t y)
+            {
+                auto const host = static_cast<FullscreenClient*>(self);
+                host->touch_focus = host->client_for(surface);
+                host->touch_focus->touch_down(touch, serial, time, surface, id, x, y);
+            },
+            [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->touch_focus->touch_up(args...); },
+            [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->touch_focus->touch_motion(args...); },
+            [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->touch_focus->touch_frame(args...); },
+            [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->touch_focus->touch_cancel(args...); },
 #ifdef WL_TOUCH_SHAPE_SINCE_VERSION
-            [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->touch_shape(args...); },
+            [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->touch_focus->touch_shape(args...); },
 #endif
 #ifdef WL_TOUCH_ORIENTATION_SINCE_VERSION
-            [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->touch_orientation(args...); },
+            [](void* self, auto... args) { static_cast<FullscreenClient*>(self)->touch_focus->touch_orientation(args...); },
 #endif
         };
 
-        wl_touch_add_listener(wl_seat_get_touch(seat), &touch_listener, this);
+        touch = wl_seat_get_touch(seat);
+        wl_touch_add_listener(touch, &touch_listener, this);
     }
 }
 
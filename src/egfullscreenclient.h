@@ -24,28 +24,63 @@
 
 #include <wayland-client.h>
 
+#include <chrono>
+#include <cstddef>
 #include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
+#include <vector>
 
 namespace egmde
 {
 class FullscreenClient
 {
 public:
-    explicit FullscreenClient(wl_display* display);
+    // With a host the client shares the host's connection, globals, outputs, seat and thread (see add_guest())
+    explicit FullscreenClient(wl_display* display, FullscreenClient* host = nullptr);
 
     virtual ~FullscreenClient();
 
+    // Hooks for a compositor to collect statistics from all its internal clients. Install before any client runs.
+    struct Reports
+    {
+        std::function<void(std::ptrdiff_t bytes)> shm_mapped;   // Called with +size on mapping, -size on unmapping
+        std::function<void()> output_change_ignored;           // An output update that changed nothing we draw
+    };
+
+    static void report_to(Reports reports);
+
     void run(wl_display* display);
 
+    // Stops run(). (Guests are stopped with their host.)
     void stop();
 
+    // Multiplex a guest (constructed with this as its host) on this client: it is sent our output events and the
+    // input events for its surfaces, and run() services its work and ticks. Call on our thread before run().
+    // The guest must be destroyed on our thread after run() returns.
+    void add_guest(FullscreenClient& guest);
+
+    // Queue work to be run on the thread executing run()
+    void invoke(std::function<void()> work);
+
+    // Call on_tick() periodically on the thread executing run(). A zero interval stops the ticks.
+    void set_tick_interval(std::chrono::nanoseconds interval);
+
+    // Creates a pool and maps it at *data. The mapping outlives the pool and must be released with unmap_shm()
     auto make_shm_pool(size_t size, void** data) const
     -> std::unique_ptr<wl_shm_pool, std::function<void(wl_shm_pool*)>>;
 
+    static void unmap_shm(void* data, size_t size);
+
+    // Creates a pool backed by an existing file of at least size bytes (e.g. a cache), without mapping it ourselves
+    auto shm_pool_from(int fd, size_t size) const
+    -> std::unique_ptr<wl_shm_pool, std::function<void(wl_shm_pool*)>>;
+
+    // Whether the compositor advertised the wl_shm format (known after the initial roundtrip)
+    auto supports_shm_format(uint32_t format) const -> bool;
+
     wl_display* display = nullptr;
     wl_compositor* compositor = nullptr;
     wl_shell* shell = nullptr;
@@ -53,10 +88,13 @@ public:
     class Output
     {
     public:
+        // What an update means for a surface on the output: nothing, a move, or new content
+        enum class Change { none, position, content };
+
         Output(
             wl_output* output,
             std::function<void(Output const&)> on_constructed,
-            std::function<void(Output const&)> on_change);
+            std::function<void(Output const&, Change)> on_change);
 
         ~Output();
 
@@ -75,6 +113,7 @@ public:
         int32_t transform = WL_OUTPUT_TRANSFORM_NORMAL;
         wl_output* output;
         int32_t scale_factor = 1;
+        int32_t refresh_mhz = 0;
     private:
         static void done(void* data, wl_output* output);
 
@@ -102,7 +141,16 @@ public:
 
         static wl_output_listener const output_listener;
 
-        std::function<void(Output const&)> on_done;
+        // Compares the current state with that at the last done event
+        auto update_last_done() -> Change;
+
+        struct State
+        {
+            int32_t x, y, width, height, transform, scale_factor;
+        };
+
+        State last_done{};
+        std::function<void(Output const&, Change)> on_done;
     };
 
     struct SurfaceInfo
@@ -124,7 +172,30 @@ public:
 
     virtual void draw_screen(SurfaceInfo& info) const = 0;
 
+    // Calls f for each output that has a surface (i.e. excluding hidden outputs)
+    void for_each_output(std::function<void(Output const&)> const& f) const;
+
+    // Calls draw_screen() for every surface
+    void redraw();
+
 protected:
+    // The WL_SEAT_CAPABILITY_* input the client handles. Nothing is bound, and no input events are received,
+    // for the rest. (Called once the client is constructed, or added as a guest.)
+    virtual auto input_capabilities() const -> uint32_t;
+
+    virtual void on_tick();
+
+    // Called (with the output bookkeeping locked) when outputs are added, changed or removed
+    virtual void on_outputs_updated(size_t visible, size_t hidden);
+
+    // Called (with the output bookkeeping locked) when an output has moved without changing size, scale or
+    // transform. The surface content is still valid, so by default nothing is done.
+    virtual void output_moved(SurfaceInfo& info) const;
+
+    // The bounding rectangle of the outputs that have a surface (allowing for rotation), in buffer pixels: each
+    // output's logical position is multiplied by its scale to line up with its pixels.
+    // Requires the output bookkeeping to be locked, i.e. call from draw_screen() or on_outputs_updated()
+    auto display_extents() const -> mir::geometry::Rectangle;
 
     virtual void keyboard_keymap(wl_keyboard* keyboard, uint32_t format, int32_t fd, uint32_t size);
     virtual void keyboard_enter(wl_keyboard* keyboard, uint32_t serial, wl_surface* surface, wl_array* keys);
@@ -186,14 +257,34 @@ protected:
         wl_fixed_t orientation);
 
 private:
+    // The client owning surface (or this, if none do)
+    auto client_for(wl_surface* surface) -> FullscreenClient*;
+    auto owns(wl_surface* surface) const -> bool;
+
+    // Services the flush, work and tick notifications of this client
+    void handle_signals(short flush_events, short work_events, short tick_events);
+
+    FullscreenClient* const host;
+    std::vector<FullscreenClient*> guests;
+
+    // Where input events without a surface are routed
+    FullscreenClient* keyboard_focus = this;
+    FullscreenClient* pointer_focus = this;
+    FullscreenClient* touch_focus = this;
+
     void on_new_output(Output const*);
 
-    void on_output_changed(Output const*);
+    void on_output_changed(Output const*, Output::Change change);
 
     void on_output_gone(Output const*);
 
     mir::Fd const flush_signal;
     mir::Fd const shutdown_signal;
+    mir::Fd const work_signal;
+    mir::Fd const tick_timer;
+
+    std::mutex work_mutex;
+    std::vector<std::function<void()>> work_queue;
 
     std::mutex mutable outputs_mutex;
     std::map<Output const*, SurfaceInfo> outputs;
@@ -202,6 +293,7 @@ private:
 
     wl_seat* seat = nullptr;
     wl_shm* shm = nullptr;
+    std::vector<uint32_t> shm_formats;
 
     void new_global(
         struct wl_registry* registry,
@@ -216,6 +308,14 @@ private:
     void seat_capabilities(wl_seat* seat, uint32_t capabilities);
     void seat_name(wl_seat* seat, const char* name);
 
+    // Binds (or releases) input devices to match what the seat has and we (and our guests) need
+    void update_input_devices();
+
+    uint32_t seat_caps = 0;
+    wl_pointer* pointer = nullptr;
+    wl_keyboard* keyboard = nullptr;
+    wl_touch* touch = nullptr;
+
     std::unique_ptr<wl_registry, decltype(&wl_registry_destroy)> registry;
 
     std::unordered_map<uint32_t, std::unique_ptr<Output>> bound_outputs;
@@ -18,55 +18,515 @@
 
 #include "egwallpaper.h"
 #include "egfullscreenclient.h"
+#include "frame_statistics.h"
 
+#include <mir/log.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <iterator>
 #include <cstring>
+#include <filesystem>
+#include <map>
 #include <sstream>
 
 namespace
 {
-void render_gradient(int32_t width, int32_t height, unsigned char* row_, uint8_t const* bottom_colour, uint8_t const* top_colour)
+// Writes rows of a single pixel format. Colours are in ARGB8888 (little-endian) byte order.
+template<uint32_t format>
+struct PixelKernel;
+
+template<>
+struct PixelKernel<WL_SHM_FORMAT_ARGB8888>
+{
+    using Pixel = uint32_t;
+
+    static void fill_row(Pixel* row, int32_t width, int32_t /*y*/, uint8_t const* colour)
+    {
+        Pixel pixel;
+        memcpy(&pixel, colour, sizeof pixel);
+        std::fill(row, row + width, pixel);
+    }
+};
+
+// The compositor can skip blending an opaque format
+template<>
+struct PixelKernel<WL_SHM_FORMAT_XRGB8888> : PixelKernel<WL_SHM_FORMAT_ARGB8888>
+{
+};
+
+template<>
+struct PixelKernel<WL_SHM_FORMAT_RGB565>
 {
-    auto row = row_;
+    using Pixel = uint16_t;
+
+    // A gradient bands badly at 5 and 6 bits per channel, so we use ordered (Bayer) dithering. That repeats every
+    // four pixels, so each row is filled from four precomputed pixels.
+    static void fill_row(Pixel* row, int32_t width, int32_t y, uint8_t const* colour)
+    {
+        static uint8_t constexpr bayer[4][4] = {{0, 8, 2, 10}, {12, 4, 14, 6}, {3, 11, 1, 9}, {15, 7, 13, 5}};
+
+        auto const quantize = [](int value, int bits, int threshold)
+            {
+                auto const max = (1 << bits) - 1;
+                return std::min((value*max + threshold*255/16) / 255, max);
+            };
+
+        Pixel pattern[4];
+        for (auto x = 0; x != 4; ++x)
+        {
+            auto const threshold = bayer[y % 4][x];
+            pattern[x] =
+                quantize(colour[2], 5, threshold) << 11 |
+                quantize(colour[1], 6, threshold) << 5 |
+                quantize(colour[0], 5, threshold);
+        }
+
+        for (auto x = 0; x < width; ++x)
+            row[x] = pattern[x % 4];
+    }
+};
+
+template<uint32_t format>
+void render_gradient(
+    int32_t width, int32_t height, int32_t stride, unsigned char* row,
+    uint8_t const* bottom_colour, uint8_t const* top_colour)
+{
+    using Kernel = PixelKernel<format>;
+
     for (int j = 0; j < height; j++)
     {
-        auto* pixel = (uint32_t*)row;
-        uint8_t pattern_[4];
+        uint8_t colour[4];
         for (auto i = 0; i != 3; ++i)
-            pattern_[i] = (j*bottom_colour[i] + (height - j) * top_colour[i]) / height;
-        pattern_[3] = 0xff;
+            colour[i] = (j*bottom_colour[i] + (height - j) * top_colour[i]) / height;
+        colour[3] = 0xff;
 
-        for (int i = 0; i < width; i++)
-            memcpy(pixel + i, pattern_, sizeof pixel[i]);
-
-        row += 4*width;
+        Kernel::fill_row(reinterpret_cast<typename Kernel::Pixel*>(row), width, j, colour);
+        row += stride;
     }
 }
+
+// The wl_shm format the wallpaper is drawn in, with its kernel
+struct PixelFormat
+{
+    uint32_t format;
+    int32_t colour_depth;
+    int32_t bytes_per_pixel;
+    void (*render)(int32_t width, int32_t height, int32_t stride, unsigned char* row,
+        uint8_t const* bottom_colour, uint8_t const* top_colour);
+
+    // Keep rows 4 byte aligned for the benefit of texture uploads
+    auto stride_for(int32_t width) const -> int32_t { return (bytes_per_pixel*width + 3) & ~3; }
+};
+
+template<uint32_t format>
+auto constexpr make_pixel_format(int32_t colour_depth) -> PixelFormat
+{
+    return {format, colour_depth, sizeof(typename PixelKernel<format>::Pixel), &render_gradient<format>};
+}
+
+// In order of preference (i.e. cheapest first). ARGB8888 is supported by every compositor.
+PixelFormat constexpr pixel_formats[] = {
+    make_pixel_format<WL_SHM_FORMAT_RGB565>(16),
+    make_pixel_format<WL_SHM_FORMAT_XRGB8888>(24),
+    make_pixel_format<WL_SHM_FORMAT_ARGB8888>(24),
+};
+
+// Parses an RGB value into ARGB8888 (little-endian) byte order
+auto parse_colour(std::string const& option, uint8_t* colour) -> bool
+{
+    uint32_t value;
+    std::stringstream interpreter{option};
+
+    if (!(interpreter >> std::hex >> value))
+        return false;
+
+    colour[0] = value & 0xff;
+    colour[1] = (value >> 8) & 0xff;
+    colour[2] = (value >> 16) & 0xff;
+    colour[3] = 0xff;
+    return true;
+}
+
+// Bump this whenever a change to the rendering (e.g. the gradient or the dither) changes the pixels drawn, so that
+// cached wallpapers from an earlier version are redrawn
+uint32_t constexpr renderer_version = 1;
+
+// A cached wallpaper is this header followed by the pixels. The header is only written once the pixels are complete
+// and the file is synced before it gets its cache name, so checking the header is enough to trust the pixels. (A
+// file that is zero-filled by a power cut fails the header checksum.)
+struct CacheHeader
+{
+    char magic[8];          // "FRMGRAD2"
+    uint32_t version;       // renderer_version
+    uint32_t format;        // wl_shm format
+    int32_t width;
+    int32_t height;
+    int32_t stride;
+    uint32_t reserved;
+    uint64_t size;          // of the pixels
+    uint8_t top_colour[4];
+    uint8_t bottom_colour[4];
+    uint64_t checksum;      // of the header fields above
+};
+
+static_assert(sizeof(CacheHeader) % 8 == 0, "the pixels that follow a CacheHeader need to stay aligned");
+
+char constexpr cache_magic[8] = {'F', 'R', 'M', 'G', 'R', 'A', 'D', '2'};
+
+// FNV-1a
+auto checksum(CacheHeader const& header) -> uint64_t
+{
+    uint64_t constexpr prime = 0x100000001b3;
+    uint64_t hash = 0xcbf29ce484222325;
+
+    auto const data = reinterpret_cast<unsigned char const*>(&header);
+    for (size_t i = 0; i != offsetof(CacheHeader, checksum); ++i)
+        hash = (hash ^ data[i]) * prime;
+
+    return hash;
+}
 }
 
 struct egmde::Wallpaper::Self : egmde::FullscreenClient
 {
-    Self(wl_display* display, uint8_t* bottom_colour, uint8_t* top_colour);
+    using Clock = std::chrono::steady_clock;
+
+    Self(
+        wl_display* display, FullscreenClient& host, uint8_t* bottom_colour, uint8_t* top_colour,
+        Playlist playlist, bool spanning, int colour_depth, std::string cache_directory);
 
     void draw_screen(SurfaceInfo& info) const override;
+    void on_outputs_updated(size_t visible, size_t hidden) override;
+    void output_moved(SurfaceInfo& info) const override;
+    void on_tick() override;
+
+    void create_surface(SurfaceInfo& info) const;
 
     uint8_t* const bottom_colour;
     uint8_t* const top_colour;
+
+    // Chosen from the formats the compositor supports once they are known (after the initial roundtrips)
+    PixelFormat const* pixel_format = nullptr;
+
+    using Pool = std::unique_ptr<wl_shm_pool, std::function<void(wl_shm_pool*)>>;
+
+    // A pool holding size bytes of gradient at offset
+    struct Gradient
+    {
+        Pool pool;
+        int32_t offset;
+    };
+
+    // The gradient from the cache if it is there, otherwise rendered (and cached when there is a cache directory)
+    auto gradient_pool(int32_t width, int32_t height, int32_t stride, size_t size) const -> Gradient;
+    auto cached_gradient_pool(int32_t width, int32_t height, int32_t stride, size_t size) const -> Gradient;
+
+    std::string const cache_directory;
+
+    // Coalesces redraws for several colour changes (or output changes when spanning)
+    bool mutable redraw_pending = false;
+    void schedule_redraw() const;
+
+    // When spanning the gradient is rendered once across the display extents into a single pool, and each
+    // output's buffer is a window into it
+    struct Span
+    {
+        Gradient gradient;
+        size_t size;
+        mir::geometry::Rectangle extents;
+        uint8_t top[4];
+        uint8_t bottom[4];
+    };
+
+    bool const spanning;
+    std::unique_ptr<Span> mutable span;
+
+    void draw_span(SurfaceInfo& info, int32_t width, int32_t height) const;
+
+    // A position in the playlist: step 0 holds an entry, steps 1..transition_frames fade into the next one
+    struct Key
+    {
+        int entry;
+        int step;
+
+        auto operator==(Key const& that) const -> bool { return entry == that.entry && step == that.step; }
+    };
+
+    // A small ring of buffers per output that frames are rendered into ahead of being shown
+    struct Animation;
+
+    Playlist const playlist;
+    Clock::time_point const start = Clock::now();
+    std::map<Output const*, std::unique_ptr<Animation>> mutable animations;
+
+    auto animated() const -> bool { return playlist.entries.size() > 1; }
+
+    // The key for a time, and how long until the key changes
+    auto key_at(Clock::time_point time) const -> std::pair<Key, Clock::duration>;
+    auto next_key(Key key) const -> Key;
+
+    void show(Animation& animation, Key key) const;
+    void catch_up() const;
+    void draw_animation(SurfaceInfo& info, int32_t width, int32_t height) const;
 };
 
-void egmde::Wallpaper::Self::draw_screen(SurfaceInfo& info) const
+struct egmde::Wallpaper::Self::Animation
 {
-    bool const rotated = info.output->transform & WL_OUTPUT_TRANSFORM_90;
-    auto const width = rotated ? info.output->height : info.output->width;
-    auto const height = rotated ? info.output->width : info.output->height;
+    static auto constexpr ring_size = 3;
 
-    if (width <= 0 || height <= 0)
-        return;
+    struct Buffer
+    {
+        wl_buffer* buffer = nullptr;
+        uint8_t* pixels = nullptr;
+        bool busy = false;
+        Key content{-1, -1};
+    };
+
+    Animation(Self const& self, int32_t width, int32_t height);
+    ~Animation();
+
+    void render(Buffer& buffer, Key key) const;
+
+    template<typename Predicate>
+    auto find(Predicate predicate) -> Buffer*
+    {
+        auto const found = std::find_if(begin(buffers), end(buffers), predicate);
+        return found != end(buffers) ? &*found : nullptr;
+    }
+
+    Self const& self;
+    int32_t const width;
+    int32_t const height;
+    size_t const size;
+    void* mapping = nullptr;
+    std::array<Buffer, ring_size> buffers;
+
+    wl_surface* surface = nullptr;
+    int32_t scale = 1;
+    wl_callback* frame_callback = nullptr;
+    Key shown{-1, -1};
+    bool live = false;      // Whether the output is still there (see catch_up())
+
+    static wl_buffer_listener const buffer_listener;
+    static wl_callback_listener const frame_listener;
+};
+
+wl_buffer_listener const egmde::Wallpaper::Self::Animation::buffer_listener{
+    [](void* data, wl_buffer*) { static_cast<Buffer*>(data)->busy = false; }
+};
+
+wl_callback_listener const egmde::Wallpaper::Self::Animation::frame_listener{
+    [](void* data, wl_callback* callback, uint32_t)
+    {
+        auto const animation = static_cast<Animation*>(data);
+        wl_callback_destroy(callback);
+        animation->frame_callback = nullptr;
+
+        // If a frame became due while the compositor was busy with the last one, catch up now.
+        // (This may destroy the animation if its output has gone.)
+        animation->self.catch_up();
+    }
+};
+
+egmde::Wallpaper::Self::Animation::Animation(Self const& self, int32_t width, int32_t height) :
+    self{self},
+    width{width},
+    height{height},
+    size{size_t(self.pixel_format->stride_for(width))*height*ring_size}
+{
+    auto const shm_pool = self.make_shm_pool(size, &mapping);
+    auto const stride = self.pixel_format->stride_for(width);
+    auto const frame_size = stride*height;
+
+    for (auto i = 0; i != ring_size; ++i)
+    {
+        auto& buffer = buffers[i];
+        buffer.pixels = static_cast<uint8_t*>(mapping) + i*frame_size;
+        buffer.buffer = wl_shm_pool_create_buffer(
+            shm_pool.get(), i*frame_size, width, height, stride, self.pixel_format->format);
+        wl_buffer_add_listener(buffer.buffer, &buffer_listener, &buffer);
+    }
+}
+
+egmde::Wallpaper::Self::Animation::~Animation()
+{
+    if (frame_callback)
+        wl_callback_destroy(frame_callback);
+
+    for (auto& buffer : buffers)
+        wl_buffer_destroy(buffer.buffer);
+
+    unmap_shm(mapping, size);
+}
+
+void egmde::Wallpaper::Self::Animation::render(Buffer& buffer, Key key) const
+{
+    auto const& entries = self.playlist.entries;
+    auto const& from = entries[key.entry];
+    auto const& to = entries[(key.entry + 1) % entries.size()];
+    auto const fraction = key.step / (self.playlist.transition_frames + 1.0);
+
+    uint8_t top[4];
+    uint8_t bottom[4];
+    for (auto i = 0; i != 4; ++i)
+    {
+        top[i] = from.top[i] + fraction*(to.top[i] - from.top[i]);
+        bottom[i] = from.bottom[i] + fraction*(to.bottom[i] - from.bottom[i]);
+    }
+
+    self.pixel_format->render(width, height, self.pixel_format->stride_for(width), buffer.pixels, bottom, top);
+    buffer.content = key;
+    ++frame_statistics.wallpaper_redraws;
+}
+
+auto egmde::Wallpaper::Self::key_at(Clock::time_point time) const -> std::pair<Key, Clock::duration>
+{
+    using namespace std::chrono;
+
+    Clock::duration const frame = duration_cast<Clock::duration>(seconds{1}) / playlist.frames_per_second;
+    Clock::duration const hold = seconds{playlist.period_seconds};
+    auto const cycle = hold + frame*playlist.transition_frames;
+
+    auto const elapsed = time - start;
+    int const entry = (elapsed / cycle) % playlist.entries.size();
+    auto const into = elapsed % cycle;
+
+    if (into < hold)
+    {
+        return {{entry, 0}, hold - into};
+    }
+
+    auto const fading = into - hold;
+    return {{entry, int(1 + fading / frame)}, frame - fading % frame};
+}
+
+auto egmde::Wallpaper::Self::next_key(Key key) const -> Key
+{
+    if (key.step < playlist.transition_frames)
+        return {key.entry, key.step + 1};
+
+    return {int((key.entry + 1) % playlist.entries.size()), 0};
+}
+
+void egmde::Wallpaper::Self::show(Animation& animation, Key key) const
+{
+    // Reuse a buffer that already has this frame, otherwise render into one the compositor has released
+    auto buffer = animation.find([&](auto const& candidate) { return candidate.content == key; });
+    if (!buffer)
+    {
+        buffer = animation.find([](auto const& candidate) { return !candidate.busy; });
+
+        // Everything is still in use, we'll try again on the next tick or frame callback
+        if (!buffer)
+            return;
+
+        animation.render(*buffer, key);
+    }
+
+    wl_surface_attach(animation.surface, buffer->buffer, 0, 0);
+    wl_surface_damage(animation.surface, 0, 0, INT32_MAX, INT32_MAX);
+    wl_surface_set_buffer_scale(animation.surface, animation.scale);
+    animation.frame_callback = wl_surface_frame(animation.surface);
+    wl_callback_add_listener(animation.frame_callback, &Animation::frame_listener, &animation);
+    wl_surface_commit(animation.surface);
+
+    buffer->busy = true;
+    animation.shown = key;
+
+    // Prepare the next frame while the compositor is busy, so it is ready to attach when due
+    auto const next = next_key(key);
+    if (!animation.find([&](auto const& candidate) { return candidate.content == next; }))
+    {
+        if (auto const spare = animation.find([](auto const& candidate) { return !candidate.busy; }))
+            animation.render(*spare, next);
+    }
+}
+
+void egmde::Wallpaper::Self::draw_animation(SurfaceInfo& info, int32_t width, int32_t height) const
+{
+    // The ring's buffers are owned by the animation
+    if (info.buffer)
+    {
+        wl_buffer_destroy(info.buffer);
+        info.buffer = nullptr;
+    }
+
+    auto& animation = animations[info.output];
+    if (!animation || animation->width != width || animation->height != height)
+    {
+        animation.reset();
+        animation = std::make_unique<Animation>(*this, width, height);
+    }
+
+    if (animation->frame_callback)
+    {
+        wl_callback_destroy(animation->frame_callback);
+        animation->frame_callback = nullptr;
+    }
+
+    animation->surface = info.surface;
+    animation->scale = info.output->scale_factor;
+    show(*animation, key_at(Clock::now()).first);
+}
+
+void egmde::Wallpaper::Self::catch_up() const
+{
+    // Outputs may have gone (and their surfaces with them) since the animations were created. The animations are
+    // marked in place as this runs every frame and shouldn't allocate.
+    for (auto const& [_, animation] : animations)
+        animation->live = false;
+
+    for_each_output([this](Output const& output)
+        {
+            if (auto const i = animations.find(&output); i != end(animations))
+                i->second->live = true;
+        });
+
+    for (auto i = begin(animations); i != end(animations);)
+    {
+        if (i->second->live)
+            ++i;
+        else
+            i = animations.erase(i);
+    }
+
+    auto const key = key_at(Clock::now()).first;
+
+    for (auto const& [_, animation] : animations)
+    {
+        // While a frame callback is outstanding the compositor hasn't shown the last frame yet. We'll
+        // catch up when it arrives.
+        if (!animation->frame_callback && !(animation->shown == key))
+            show(*animation, key);
+    }
+}
+
+void egmde::Wallpaper::Self::on_tick()
+{
+    catch_up();
 
-    auto const stride = 4*width;
+    auto const remaining = key_at(Clock::now()).second;
+    set_tick_interval(std::max<Clock::duration>(remaining, std::chrono::milliseconds{1}));
+}
 
+void egmde::Wallpaper::Self::create_surface(SurfaceInfo& info) const
+{
     if (!info.surface)
     {
         info.surface = wl_compositor_create_surface(compositor);
+
+        // We don't handle input, so the compositor shouldn't send us any
+        auto const region = wl_compositor_create_region(compositor);
+        wl_surface_set_input_region(info.surface, region);
+        wl_region_destroy(region);
     }
 
     if (!info.shell_surface)
@@ -78,6 +538,32 @@ void egmde::Wallpaper::Self::draw_screen(SurfaceInfo& info) const
             0,
             info.output->output);
     }
+}
+
+void egmde::Wallpaper::Self::draw_screen(SurfaceInfo& info) const
+{
+    bool const rotated = info.output->transform & WL_OUTPUT_TRANSFORM_90;
+    auto const width = rotated ? info.output->height : info.output->width;
+    auto const height = rotated ? info.output->width : info.output->height;
+
+    if (width <= 0 || height <= 0 || !pixel_format)
+        return;
+
+    auto const stride = pixel_format->stride_for(width);
+
+    create_surface(info);
+
+    if (animated())
+    {
+        draw_animation(info, width, height);
+        return;
+    }
+
+    if (spanning)
+    {
+        draw_span(info, width, height);
+        return;
+    }
 
     if (info.buffer)
     {
@@ -85,84 +571,409 @@ void egmde::Wallpaper::Self::draw_screen(SurfaceInfo& info) const
     }
 
     {
-        auto const shm_pool = make_shm_pool(stride * height, &info.content_area);
+        auto const gradient = gradient_pool(width, height, stride, size_t(stride)*height);
 
         info.buffer = wl_shm_pool_create_buffer(
-            shm_pool.get(),
-            0,
+            gradient.pool.get(),
+            gradient.offset,
             width, height, stride,
-            WL_SHM_FORMAT_ARGB8888);
+            pixel_format->format);
+    }
+
+    wl_surface_attach(info.surface, info.buffer, 0, 0);
+    wl_surface_set_buffer_scale(info.surface, info.output->scale_factor);
+    wl_surface_commit(info.surface);
+}
+
+void egmde::Wallpaper::Self::draw_span(SurfaceInfo& info, int32_t width, int32_t height) const
+{
+    auto const extents = display_extents();
+
+    if (!span || span->extents != extents ||
+        memcmp(span->top, top_colour, sizeof span->top) || memcmp(span->bottom, bottom_colour, sizeof span->bottom))
+    {
+        auto const span_width = extents.size.width.as_int();
+        auto const span_height = extents.size.height.as_int();
+
+        // A buffer's offset + height*stride must lie within the pool, which for a window into the right hand
+        // side of the span runs past the last row. One spare row covers that.
+        auto const span_stride = pixel_format->stride_for(span_width);
+        auto const size = size_t(span_stride)*(span_height + 1);
+
+        // Buffers already created keep the old pool alive in the compositor until they are replaced
+        span = std::make_unique<Span>(
+            Span{gradient_pool(span_width, span_height, span_stride, size), size, extents, {}, {}});
+        memcpy(span->top, top_colour, sizeof span->top);
+        memcpy(span->bottom, bottom_colour, sizeof span->bottom);
+
+        // The other outputs are showing windows into the previous span
+        schedule_redraw();
     }
 
-    render_gradient(width, height, static_cast<unsigned char*>(info.content_area), bottom_colour, top_colour);
+    if (info.buffer)
+    {
+        wl_buffer_destroy(info.buffer);
+    }
+
+    auto const stride = pixel_format->stride_for(extents.size.width.as_int());
+    auto const scale = info.output->scale_factor;
+    auto const offset = span->gradient.offset +
+        (info.output->y*scale - extents.top_left.y.as_int())*stride +
+        (info.output->x*scale - extents.top_left.x.as_int())*pixel_format->bytes_per_pixel;
+
+    info.buffer = wl_shm_pool_create_buffer(
+        span->gradient.pool.get(), offset, width, height, stride, pixel_format->format);
 
     wl_surface_attach(info.surface, info.buffer, 0, 0);
     wl_surface_set_buffer_scale(info.surface, info.output->scale_factor);
     wl_surface_commit(info.surface);
 }
 
-egmde::Wallpaper::Self::Self(wl_display* display, uint8_t* bottom_colour, uint8_t* top_colour) :
-    FullscreenClient(display),
-    bottom_colour{bottom_colour},
-    top_colour{top_colour}
+void egmde::Wallpaper::Self::output_moved(SurfaceInfo& info) const
 {
-    wl_display_roundtrip(display);
-    wl_display_roundtrip(display);
+    // A spanning wallpaper shows a different part of the span (and the span may have changed)
+    if (spanning && !animated())
+    {
+        draw_screen(info);
+    }
 }
 
-void egmde::Wallpaper::stop()
+auto egmde::Wallpaper::Self::gradient_pool(int32_t width, int32_t height, int32_t stride, size_t size) const
+-> Gradient
 {
-    if (auto ss = self.lock())
+    if (!cache_directory.empty())
     {
-        std::lock_guard<decltype(mutex)> lock{mutex};
-        ss->stop();
-        ss.reset();
+        if (auto gradient = cached_gradient_pool(width, height, stride, size); gradient.pool)
+            return gradient;
     }
+
+    void* content_area;
+    auto pool = make_shm_pool(size, &content_area);
+    pixel_format->render(width, height, stride, static_cast<unsigned char*>(content_area), bottom_colour, top_colour);
+
+    // The compositor has its own mapping of the pool, so we don't need ours once the content is drawn
+    unmap_shm(content_area, size);
+    ++frame_statistics.wallpaper_redraws;
+    return {std::move(pool), 0};
 }
 
+auto egmde::Wallpaper::Self::cached_gradient_pool(int32_t width, int32_t height, int32_t stride, size_t size) const
+-> Gradient
+{
+    char geometry[80];
+    snprintf(geometry, sizeof geometry, "gradient-%dx%d-%d-%zu-%08x-", width, height, stride, size, pixel_format->format);
 
-void egmde::Wallpaper::bottom(std::string const& option)
+    char colours[16];
+    snprintf(colours, sizeof colours, "%02x%02x%02x-%02x%02x%02x",
+        top_colour[2], top_colour[1], top_colour[0], bottom_colour[2], bottom_colour[1], bottom_colour[0]);
+
+    auto const path = cache_directory + "/" + geometry + colours;
+    auto const file_size = sizeof(CacheHeader) + size;
+    int32_t const offset = sizeof(CacheHeader);
+
+    // A hit needs no rendering: once its header is checked, the file is handed to the compositor as the pool
+    if (mir::Fd const fd{open(path.c_str(), O_RDWR | O_CLOEXEC)}; fd >= 0)
+    {
+        struct stat status;
+        CacheHeader header;
+        if (fstat(fd, &status) == 0 && size_t(status.st_size) == file_size &&
+            pread(fd, &header, sizeof header, 0) == sizeof header)
+        {
+            bool const valid =
+                memcmp(header.magic, cache_magic, sizeof header.magic) == 0 &&
+                header.version == renderer_version &&
+                header.format == pixel_format->format &&
+                header.width == width && header.height == height && header.stride == stride &&
+                header.size == size &&
+                memcmp(header.top_colour, top_colour, sizeof header.top_colour) == 0 &&
+                memcmp(header.bottom_colour, bottom_colour, sizeof header.bottom_colour) == 0 &&
+                header.checksum == checksum(header);
+
+            if (valid)
+            {
+                ++frame_statistics.wallpaper_cache_hits;
+                return {shm_pool_from(fd, file_size), offset};
+            }
+        }
+
+        mir::log_debug("Replacing invalid cached wallpaper %s", path.c_str());
+    }
+
+    // Render into a temporary file that only gets the cache name once it is complete
+    auto temporary = cache_directory + "/.gradient-XXXXXX";
+    mir::Fd const fd{mkostemp(temporary.data(), O_CLOEXEC)};
+    if (fd < 0)
+    {
+        mir::log_debug("Not caching the wallpaper in %s: %s", cache_directory.c_str(), strerror(errno));
+        return {};
+    }
+
+    void* file = MAP_FAILED;
+    if (posix_fallocate(fd, 0, file_size) == 0)
+    {
+        file = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+
+    if (file == MAP_FAILED)
+    {
+        mir::log_debug("Not caching the wallpaper in %s: unable to allocate %zu bytes", cache_directory.c_str(), size);
+        unlink(temporary.c_str());
+        return {};
+    }
+
+    auto const contents = static_cast<unsigned char*>(file);
+    pixel_format->render(width, height, stride, contents + offset, bottom_colour, top_colour);
+
+    CacheHeader header{};
+    memcpy(header.magic, cache_magic, sizeof header.magic);
+    header.version = renderer_version;
+    header.format = pixel_format->format;
+    header.width = width;
+    header.height = height;
+    header.stride = stride;
+    header.size = size;
+    memcpy(header.top_colour, top_colour, sizeof header.top_colour);
+    memcpy(header.bottom_colour, bottom_colour, sizeof header.bottom_colour);
+    header.checksum = checksum(header);
+    memcpy(contents, &header, sizeof header);
+
+    munmap(file, file_size);
+    ++frame_statistics.wallpaper_redraws;
+
+    // The contents must be on disk before the name is: otherwise a power cut can leave the cache name on a file
+    // that was never written
+    if (fsync(fd) != 0)
+    {
+        mir::log_debug("Not caching the wallpaper in %s: %s", cache_directory.c_str(), strerror(errno));
+        unlink(temporary.c_str());
+        return {shm_pool_from(fd, file_size), offset};
+    }
+
+    // Only the latest colours are kept for each geometry and format
+    std::error_code ignored;
+    for (auto const& entry : std::filesystem::directory_iterator{cache_directory, ignored})
+    {
+        if (entry.path().filename().string().rfind(geometry, 0) == 0)
+            std::filesystem::remove(entry.path(), ignored);
+    }
+
+    if (rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        unlink(temporary.c_str());
+    }
+    else if (mir::Fd const directory{open(cache_directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)}; directory >= 0)
+    {
+        fsync(directory);
+    }
+
+    return {shm_pool_from(fd, file_size), offset};
+}
+
+void egmde::Wallpaper::Self::schedule_redraw() const
 {
-    uint32_t value;
-    std::stringstream interpreter{option};
+    if (!redraw_pending)
+    {
+        redraw_pending = true;
+
+        // draw_screen() is const, but redrawing from the work queue happens outside of it
+        auto const self = const_cast<Self*>(this);
+        self->invoke([self] { self->redraw_pending = false; self->redraw(); });
+    }
+}
+
+void egmde::Wallpaper::Self::on_outputs_updated(size_t visible, size_t hidden)
+{
+    frame_statistics.outputs_visible = visible;
+    frame_statistics.outputs_hidden = hidden;
+
+    // Removing an output may shrink the extents, and that doesn't redraw the remaining outputs
+    if (spanning && span && span->extents != display_extents())
+    {
+        schedule_redraw();
+    }
+}
+
+egmde::Wallpaper::Self::Self(
+    wl_display* display, FullscreenClient& host, uint8_t* bottom_colour, uint8_t* top_colour,
+    Playlist playlist, bool spanning, int colour_depth, std::string cache_directory) :
+    FullscreenClient(display, &host),
+    bottom_colour{bottom_colour},
+    top_colour{top_colour},
+    cache_directory{std::move(cache_directory)},
+    spanning{spanning},
+    playlist{std::move(playlist)}
+{
+    // Remove anything left by an earlier run that stopped part way through caching
+    if (!this->cache_directory.empty())
+    {
+        std::error_code ignored;
+        std::filesystem::create_directories(this->cache_directory, ignored);
+        for (auto const& entry : std::filesystem::directory_iterator{this->cache_directory, ignored})
+        {
+            if (entry.path().filename().string().rfind(".gradient-", 0) == 0)
+                std::filesystem::remove(entry.path(), ignored);
+        }
+    }
+
+    // The cheapest format with enough colour depth for the panels (ARGB8888 is always supported)
+    pixel_format = &pixel_formats[std::size(pixel_formats) - 1];
+    for (auto const& candidate : pixel_formats)
+    {
+        if (candidate.colour_depth >= colour_depth && supports_shm_format(candidate.format))
+        {
+            pixel_format = &candidate;
+            break;
+        }
+    }
+
+    // Outputs that arrived during the roundtrips haven't been drawn yet
+    redraw();
 
-    if (interpreter >> std::hex >> value)
+    if (animated())
     {
-        bottom_colour[0] = value & 0xff;
-        bottom_colour[1] = (value >> 8) & 0xff;
-        bottom_colour[2] = (value >> 16) & 0xff;
+        set_tick_interval(key_at(Clock::now()).second);
     }
 }
 
+void egmde::Wallpaper::bottom(std::string const& option)
+{
+    set_colour(bottom_colour, option);
+}
+
 void egmde::Wallpaper::top(std::string const& option)
 {
-    uint32_t value;
-    std::stringstream interpreter{option};
+    set_colour(top_colour, option);
+}
+
+void egmde::Wallpaper::set_colour(uint8_t* colour, std::string const& option)
+{
+    uint8_t value[4];
+
+    if (!parse_colour(option, value))
+        return;
+
+    auto const update = [colour, value0=value[0], value1=value[1], value2=value[2]]
+        {
+            colour[0] = value0;
+            colour[1] = value1;
+            colour[2] = value2;
+        };
+
+    std::lock_guard<decltype(mutex)> lock{mutex};
+
+    // The playlist overrides the top and bottom colours
+    if (!playlist_settings.entries.empty())
+        return;
+
+    // The client thread reads the colours while drawing, so change them there
+    bool const running = with_client<Self>([&](Self& client)
+        {
+            client.invoke([update, client=&client]
+                {
+                    update();
+                    client->schedule_redraw();
+                });
+        });
 
-    if (interpreter >> std::hex >> value)
+    if (!running)
     {
-        top_colour[0] = value & 0xff;
-        top_colour[1] = (value >> 8) & 0xff;
-        top_colour[2] = (value >> 16) & 0xff;
+        update();
     }
 }
 
-void egmde::Wallpaper::operator()(wl_display* display)
+void egmde::Wallpaper::playlist(std::string const& option)
 {
-    auto client = std::make_shared<Self>(display, bottom_colour, top_colour);
+    std::vector<ColourPair> entries;
+    std::stringstream list{option};
+
+    for (std::string entry; std::getline(list, entry, ',');)
     {
-        std::lock_guard<decltype(mutex)> lock{mutex};
-        self = client;
+        auto const separator = entry.find(':');
+        ColourPair pair;
+
+        if (separator == std::string::npos ||
+            !parse_colour(entry.substr(0, separator), pair.top) ||
+            !parse_colour(entry.substr(separator + 1), pair.bottom))
+        {
+            mir::log_warning("Ignoring invalid wallpaper playlist entry '%s' (expected top:bottom)", entry.c_str());
+            continue;
+        }
+
+        entries.push_back(pair);
+    }
+
+    std::lock_guard<decltype(mutex)> lock{mutex};
+
+    // A single entry is a static wallpaper, which is drawn (spanned and cached) from the top and bottom colours
+    if (entries.size() == 1)
+    {
+        memcpy(top_colour, entries.front().top, sizeof top_colour);
+        memcpy(bottom_colour, entries.front().bottom, sizeof bottom_colour);
     }
-    client->run(display);
 
-    // Possibly need to wait for stop() to release the client.
-    // (This would be less ugly with a ref-counted wrapper for wl_display* in the miral API)
+    playlist_settings.entries = std::move(entries);
+}
+
+void egmde::Wallpaper::playlist_period(int seconds)
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    playlist_settings.period_seconds = std::max(seconds, 1);
+}
+
+void egmde::Wallpaper::transition_frames(int frames)
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    playlist_settings.transition_frames = std::max(frames, 0);
+}
+
+void egmde::Wallpaper::animation_rate(int frames_per_second)
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    playlist_settings.frames_per_second = std::clamp(frames_per_second, 1, 60);
+}
+
+void egmde::Wallpaper::colour_depth(int bits)
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    depth = bits;
+}
+
+void egmde::Wallpaper::cache_directory(std::string const& option)
+{
     std::lock_guard<decltype(mutex)> lock{mutex};
-    client.reset();
+    cache = option;
 }
 
-void egmde::Wallpaper::operator()(std::weak_ptr<mir::scene::Session> const& /*session*/)
+void egmde::Wallpaper::span(bool span)
 {
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    spanning = span;
 }
 
+auto egmde::Wallpaper::connect(wl_display* display, FullscreenClient& host) -> std::shared_ptr<FullscreenClient>
+{
+    Playlist playlist;
+    bool span;
+    int bits;
+    std::string directory;
+    {
+        std::lock_guard<decltype(mutex)> lock{mutex};
+        playlist = playlist_settings;
+        span = spanning;
+        bits = depth;
+        directory = cache;
+    }
+
+    if (directory.empty())
+    {
+        if (auto const snap_data = getenv("SNAP_DATA"))
+            directory = std::string{snap_data} + "/wallpaper-cache";
+    }
+    else if (directory == "none")
+    {
+        directory.clear();
+    }
+
+    return std::make_shared<Self>(
+        display, host, bottom_colour, top_colour, std::move(playlist), span, bits, std::move(directory));
+}
@@ -19,35 +19,70 @@
 #ifndef EGMDE_EGWALLPAPER_H
 #define EGMDE_EGWALLPAPER_H
 
-#include <miral/application.h>
+#include "frame_client_host.h"
 
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
-struct wl_display;
 namespace egmde
 {
-class Wallpaper
+class Wallpaper : public FrameHostedClient
 {
 public:
-    void operator()(wl_display* display);
-    void operator()(std::weak_ptr<mir::scene::Session> const& session);
-
-    void stop();
-
-    // Used in initialization to set colour
+    // Used in initialization to set colour, and may be called later to change it
     void bottom(std::string const& option);
     void top(std::string const& option);
 
+    // Used in initialization to cycle through a list of "top:bottom" colour pairs (separated by commas),
+    // cross-fading between them. This overrides the top and bottom colours.
+    void playlist(std::string const& option);
+    void playlist_period(int seconds);
+    void transition_frames(int frames);
+    void animation_rate(int frames_per_second);
+
+    // Used in initialization to stretch a single gradient across all outputs (e.g. for a video wall)
+    void span(bool span);
+
+    // Used in initialization to allow a cheaper pixel format (e.g. 16 for RGB565 on 16-bit panels)
+    void colour_depth(int bits);
+
+    // Used in initialization: where rendered wallpapers are kept for fast restarts ("none" to disable)
+    void cache_directory(std::string const& option);
+
 private:
     std::mutex mutable mutex;
 
+    // Applies a colour change (directly, or on the client thread if it is running)
+    void set_colour(uint8_t* colour, std::string const& option);
+
     uint8_t bottom_colour[4] = { 0x0a, 0x24, 0x77, 0xFF };
     uint8_t top_colour[4] = { 0x00, 0x00, 0x00, 0xFF };
 
+    struct ColourPair
+    {
+        uint8_t top[4];
+        uint8_t bottom[4];
+    };
+
+    struct Playlist
+    {
+        std::vector<ColourPair> entries;
+        int period_seconds = 60;
+        int transition_frames = 15;
+        int frames_per_second = 15;
+    };
+
+    Playlist playlist_settings;
+    bool spanning = false;
+    int depth = 24;
+    std::string cache;
+
     struct Self;
-    std::weak_ptr<Self> self;
+
+    auto connect(wl_display* display, FullscreenClient& host) -> std::shared_ptr<FullscreenClient> override;
 };
 }
 
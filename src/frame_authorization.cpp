@@ -17,6 +17,7 @@
  */
 
 #include "frame_authorization.h"
+#include "frame_statistics.h"
 
 #include <miral/version.h>
 #include <mir/log.h>
@@ -41,8 +42,6 @@ AuthModel const auth_model{{
     }},
 }};
 
-namespace
-{
 auto snap_name_of(miral::Application const& app) -> std::string
 {
     int const app_fd = miral::socket_fd_of(app);
@@ -82,7 +81,6 @@ auto snap_name_of(miral::Application const& app) -> std::string
         }
     }
 }
-}
 
 AuthModel::AuthModel(
     std::vector<std::pair<std::string, std::vector<std::string>>> const& protocols_for_snaps)
@@ -108,14 +106,29 @@ void init_authorization(miral::WaylandExtensions& extensions, AuthModel const& m
 {
     for (auto const& [protocol, snaps] : model.snaps_for_protocols)
     {
-        extensions.conditionally_enable(protocol, [snaps=snaps](auto const& info)
+        auto& counters = frame_statistics.authorization(protocol);
+
+        // Our own internal clients (screenshots and thumbnails) only need screencopy
+        bool const trust_own_clients = protocol == WaylandExtensions::zwlr_screencopy_manager_v1;
+
+        extensions.conditionally_enable(protocol, [snaps=snaps, trust_own_clients, &counters](auto const& info)
             {
-                if (info.user_preference())
-                {
-                    return info.user_preference().value();
-                }
-                auto const snap_name = snap_name_of(info.app());
-                return snaps.find(snap_name) != snaps.end();
+                auto const allowed = [&]
+                    {
+                        if (info.user_preference())
+                        {
+                            return info.user_preference().value();
+                        }
+                        if (trust_own_clients && miral::pid_of(info.app()) == getpid())
+                        {
+                            return true;
+                        }
+                        auto const snap_name = snap_name_of(info.app());
+                        return snaps.find(snap_name) != snaps.end();
+                    }();
+
+                ++(allowed ? counters.allowed : counters.denied);
+                return allowed;
             });
     }
 }
@@ -19,6 +19,7 @@
 #ifndef FRAME_AUTHORIZATION_H
 #define FRAME_AUTHORIZATION_H
 
+#include <miral/application.h>
 #include <miral/wayland_extensions.h>
 #include <set>
 #include <map>
@@ -36,4 +37,7 @@ extern AuthModel const auth_model;
 
 void init_authorization(miral::WaylandExtensions& extensions, AuthModel const& model);
 
+/// The name of the snap the application is confined by (without any parallel install key), or "" if it isn't
+auto snap_name_of(miral::Application const& app) -> std::string;
+
 #endif // FRAME_AUTHORIZATION_H
@@ -0,0 +1,133 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frame_client_host.h"
+#include "egfullscreenclient.h"
+#include "frame_statistics.h"
+
+#include <mir/log.h>
+
+struct FrameClientHost::Self : egmde::FullscreenClient
+{
+    explicit Self(wl_display* display);
+
+    // The host has no surfaces of its own, it tracks the outputs for its guests
+    void draw_screen(SurfaceInfo&) const override {}
+};
+
+FrameClientHost::Self::Self(wl_display* display) :
+    FullscreenClient(display)
+{
+    wl_display_roundtrip(display);
+    wl_display_roundtrip(display);
+}
+
+FrameHostedClient::FrameHostedClient() = default;
+FrameHostedClient::~FrameHostedClient() = default;
+
+auto FrameHostedClient::operator()(wl_display* display, egmde::FullscreenClient& host) -> egmde::FullscreenClient*
+{
+    auto client = connect(display, host);
+    std::lock_guard<decltype(client_mutex)> lock{client_mutex};
+    running = client;
+    return client.get();
+}
+
+void FrameHostedClient::disconnect()
+{
+    std::shared_ptr<egmde::FullscreenClient> client;
+    {
+        std::lock_guard<decltype(client_mutex)> lock{client_mutex};
+        client = std::move(running);
+    }
+
+    // Destroyed here, on the host's thread, but outside the lock, which other threads may be waiting for
+    client.reset();
+}
+
+void FrameClientHost::add(FrameHostedClient& client)
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    hosted.push_back(&client);
+}
+
+void FrameClientHost::on_client_thread(std::function<void()> setup)
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    client_thread_setup = std::move(setup);
+}
+
+void FrameClientHost::operator()(wl_display* display)
+{
+    decltype(hosted) clients;
+    decltype(client_thread_setup) setup;
+    {
+        std::lock_guard<decltype(mutex)> lock{mutex};
+        clients = hosted;
+        setup = client_thread_setup;
+    }
+
+    // Before the clients start any worker threads, so that they inherit it
+    if (setup)
+        setup();
+
+    egmde::FullscreenClient::report_to({
+        [](std::ptrdiff_t bytes) { frame_statistics.internal_client_shm_bytes += bytes; },
+        [] { ++frame_statistics.output_changes_ignored; }});
+
+    auto host = std::make_shared<Self>(display);
+    {
+        std::lock_guard<decltype(mutex)> lock{mutex};
+        self = host;
+    }
+
+    auto guests = 0;
+    for (auto const client : clients)
+    {
+        if (auto const guest = (*client)(display, *host))
+        {
+            host->add_guest(*guest);
+            ++guests;
+        }
+    }
+
+    mir::log_info("Running %d internal clients on a shared connection", guests);
+    host->run(display);
+
+    // The guests have to go before the host
+    for (auto const client : clients)
+    {
+        client->disconnect();
+    }
+
+    // Possibly need to wait for stop() to release the client.
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    host.reset();
+}
+
+void FrameClientHost::operator()(std::weak_ptr<mir::scene::Session> const& /*session*/)
+{
+}
+
+void FrameClientHost::stop()
+{
+    if (auto ss = self.lock())
+    {
+        std::lock_guard<decltype(mutex)> lock{mutex};
+        ss->stop();
+        ss.reset();
+    }
+}
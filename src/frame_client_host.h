@@ -0,0 +1,94 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_CLIENT_HOST_H
+#define FRAME_CLIENT_HOST_H
+
+#include <miral/application.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct wl_display;
+namespace egmde { class FullscreenClient; }
+
+/// Base for the internal clients run by a FrameClientHost. The host connects each client on its thread at startup
+/// and disconnects it once stopped; in between, with_client() gives other threads access to the running client.
+class FrameHostedClient
+{
+public:
+    /// Called on the host's thread at startup, returns nullptr if the client doesn't want to run
+    auto operator()(wl_display* display, egmde::FullscreenClient& host) -> egmde::FullscreenClient*;
+
+    /// Called on the host's thread once it has stopped
+    void disconnect();
+
+protected:
+    FrameHostedClient();
+    ~FrameHostedClient();
+
+    /// Creates the running client, constructed with host as its host (or returns nullptr not to run)
+    virtual auto connect(wl_display* display, egmde::FullscreenClient& host)
+    -> std::shared_ptr<egmde::FullscreenClient> = 0;
+
+    /// Calls f with the running client, which can't disconnect until f returns. Returns false (without calling f)
+    /// if the client isn't running. Safe to call from any thread: no reference escapes, so the client is only ever
+    /// destroyed on the host's thread.
+    template<typename Client, typename F>
+    auto with_client(F&& f) const -> bool
+    {
+        std::lock_guard<decltype(client_mutex)> lock{client_mutex};
+        if (!running)
+            return false;
+
+        f(static_cast<Client&>(*running));
+        return true;
+    }
+
+private:
+    std::mutex mutable client_mutex;
+    std::shared_ptr<egmde::FullscreenClient> running;
+};
+
+/// An internal client that runs several FrameHostedClients on one connection and one thread, sharing the bound
+/// globals, output tracking and seat. Each hosted client costs no extra thread or registry roundtrips.
+class FrameClientHost
+{
+public:
+    /// Used in initialization, clients are connected in the order added
+    void add(FrameHostedClient& client);
+
+    /// Used in initialization: called on the clients' thread before they are connected
+    void on_client_thread(std::function<void()> setup);
+
+    void operator()(wl_display* display);
+    void operator()(std::weak_ptr<mir::scene::Session> const& session);
+
+    void stop();
+
+private:
+    std::mutex mutable mutex;
+
+    std::vector<FrameHostedClient*> hosted;
+    std::function<void()> client_thread_setup;
+
+    struct Self;
+    std::weak_ptr<Self> self;
+};
+
+#endif // FRAME_CLIENT_HOST_H
@@ -0,0 +1,163 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frame_config_watcher.h"
+
+#include <mir/fd.h>
+#include <mir/log.h>
+
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+// Mir reads the config file from $XDG_CONFIG_HOME (which the daemon sets to $SNAP_DATA)
+auto config_directory() -> std::string
+{
+    if (auto const config_home = getenv("XDG_CONFIG_HOME"))
+        return config_home;
+
+    if (auto const home = getenv("HOME"))
+        return std::string{home} + "/.config";
+
+    return {};
+}
+
+auto read_options(std::string const& path) -> std::map<std::string, std::string>
+{
+    std::map<std::string, std::string> options;
+    std::ifstream config{path};
+
+    for (std::string line; std::getline(config, line);)
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        auto const equals = line.find('=');
+        if (equals == std::string::npos)
+        {
+            options[line] = "";
+        }
+        else
+        {
+            options[line.substr(0, equals)] = line.substr(equals + 1);
+        }
+    }
+
+    return options;
+}
+}
+
+FrameConfigWatcher::FrameConfigWatcher(miral::MirRunner& runner) :
+    runner{runner},
+    directory{config_directory()},
+    filename{runner.config_file()}
+{
+    runner.add_start_callback([this] { start(); });
+    runner.add_stop_callback([this] { watch_handle.reset(); });
+}
+
+FrameConfigWatcher::~FrameConfigWatcher() = default;
+
+void FrameConfigWatcher::add_live_option(
+    std::string const& option,
+    std::string const& default_value,
+    std::function<void(std::string const&)> handler)
+{
+    live_options[option] = LiveOption{default_value, std::move(handler)};
+}
+
+void FrameConfigWatcher::start()
+{
+    if (directory.empty())
+        return;
+
+    current_values = read_options(directory + "/" + filename);
+
+    mir::Fd inotify{inotify_init1(IN_CLOEXEC | IN_NONBLOCK)};
+
+    // The configure hook replaces the file by renaming, so we watch the directory
+    if (inotify < 0 || inotify_add_watch(inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        mir::log_warning("Unable to watch %s for config changes: %s", directory.c_str(), strerror(errno));
+        return;
+    }
+
+    watch_handle = runner.register_fd_handler(inotify, [this](int fd)
+        {
+            alignas(inotify_event) char buffer[4096];
+            bool changed = false;
+
+            for (ssize_t length; (length = read(fd, buffer, sizeof buffer)) > 0;)
+            {
+                for (auto p = buffer; p < buffer + length;)
+                {
+                    auto const event = reinterpret_cast<inotify_event const*>(p);
+                    if (event->len && filename == event->name)
+                        changed = true;
+                    p += sizeof(inotify_event) + event->len;
+                }
+            }
+
+            if (changed)
+                reload();
+        });
+}
+
+void FrameConfigWatcher::reload()
+{
+    auto const path = directory + "/" + filename;
+    auto updated = read_options(path);
+
+    auto const value_of = [](auto const& options, std::string const& key) -> std::string
+        {
+            auto const i = options.find(key);
+            return i != options.end() ? i->second : "";
+        };
+
+    auto const changed = [&](std::string const& key)
+        {
+            return current_values.count(key) != updated.count(key) ||
+                value_of(current_values, key) != value_of(updated, key);
+        };
+
+    std::map<std::string, bool> keys;
+    for (auto const& [key, _] : current_values) keys[key];
+    for (auto const& [key, _] : updated) keys[key];
+
+    for (auto const& [key, _] : keys)
+    {
+        if (!changed(key))
+            continue;
+
+        auto const live = live_options.find(key);
+        if (live != live_options.end())
+        {
+            auto const value = updated.count(key) ? value_of(updated, key) : live->second.default_value;
+
+            mir::log_info("Applying '%s=%s' from %s", key.c_str(), value.c_str(), path.c_str());
+            live->second.handler(value);
+        }
+        else
+        {
+            mir::log_info("Option '%s' changed in %s: restart Frame to apply", key.c_str(), path.c_str());
+        }
+    }
+
+    current_values = std::move(updated);
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_CONFIG_WATCHER_H
+#define FRAME_CONFIG_WATCHER_H
+
+#include <miral/runner.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+/// Watches the config file for changes and applies the options that can be changed at runtime.
+/// Changes to other options are logged as needing a restart.
+///
+/// Note: changes to the display configuration file are already applied by miral::DisplayConfiguration.
+class FrameConfigWatcher
+{
+public:
+    explicit FrameConfigWatcher(miral::MirRunner& runner);
+    ~FrameConfigWatcher();
+
+    /// Call handler with the new value whenever option changes in the config file (or with default_value if
+    /// the option is removed)
+    void add_live_option(
+        std::string const& option,
+        std::string const& default_value,
+        std::function<void(std::string const&)> handler);
+
+private:
+    void start();
+    void reload();
+
+    miral::MirRunner& runner;
+    std::string const directory;
+    std::string const filename;
+
+    struct LiveOption
+    {
+        std::string default_value;
+        std::function<void(std::string const&)> handler;
+    };
+
+    std::map<std::string, LiveOption> live_options;
+    std::map<std::string, std::string> current_values;
+
+    std::unique_ptr<miral::FdHandle> watch_handle;
+};
+
+#endif // FRAME_CONFIG_WATCHER_H
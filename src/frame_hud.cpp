@@ -0,0 +1,473 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frame_hud.h"
+#include "frame_render_monitor.h"
+#include "frame_statistics.h"
+#include "egfullscreenclient.h"
+
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace
+{
+// A 5x7 bitmap font covering what the HUD writes. Each row is five bits, the most significant on the left.
+struct Glyph
+{
+    char c;
+    uint8_t rows[7];
+};
+
+Glyph const font[] = {
+    {' ', {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}},
+    {'%', {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03}},
+    {'(', {0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02}},
+    {')', {0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08}},
+    {'+', {0x00, 0x04, 0x04, 0x1f, 0x04, 0x04, 0x00}},
+    {'-', {0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00}},
+    {'.', {0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c}},
+    {'/', {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00}},
+    {'0', {0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e}},
+    {'1', {0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e}},
+    {'2', {0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f}},
+    {'3', {0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e}},
+    {'4', {0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02}},
+    {'5', {0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e}},
+    {'6', {0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e}},
+    {'7', {0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}},
+    {'8', {0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e}},
+    {'9', {0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c}},
+    {':', {0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00}},
+    {'<', {0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02}},
+    {'=', {0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x00}},
+    {'>', {0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08}},
+    {'A', {0x0e, 0x11, 0x11, 0x11, 0x1f, 0x11, 0x11}},
+    {'B', {0x1e, 0x11, 0x11, 0x1e, 0x11, 0x11, 0x1e}},
+    {'C', {0x0e, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0e}},
+    {'D', {0x1c, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1c}},
+    {'E', {0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x1f}},
+    {'F', {0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x10}},
+    {'G', {0x0e, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0f}},
+    {'H', {0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11}},
+    {'I', {0x0e, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e}},
+    {'J', {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0c}},
+    {'K', {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}},
+    {'L', {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f}},
+    {'M', {0x11, 0x1b, 0x15, 0x15, 0x11, 0x11, 0x11}},
+    {'N', {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}},
+    {'O', {0x0e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e}},
+    {'P', {0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10}},
+    {'Q', {0x0e, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0d}},
+    {'R', {0x1e, 0x11, 0x11, 0x1e, 0x14, 0x12, 0x11}},
+    {'S', {0x0f, 0x10, 0x10, 0x0e, 0x01, 0x01, 0x1e}},
+    {'T', {0x1f, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}},
+    {'U', {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e}},
+    {'V', {0x11, 0x11, 0x11, 0x11, 0x11, 0x0a, 0x04}},
+    {'W', {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0a}},
+    {'X', {0x11, 0x11, 0x0a, 0x04, 0x0a, 0x11, 0x11}},
+    {'Y', {0x11, 0x11, 0x11, 0x0a, 0x04, 0x04, 0x04}},
+    {'Z', {0x1f, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1f}},
+};
+
+// Each character cell is 6x9 font pixels: the glyph with a column of spacing and a row above and below
+auto constexpr cell_width = 6;
+auto constexpr cell_height = 9;
+
+auto constexpr columns = 32;
+auto constexpr lines = 7;
+
+// Premultiplied ARGB8888
+uint32_t constexpr background = 0xc0000000;
+uint32_t constexpr foreground = 0xfff0f0f0;
+
+using Text = std::array<std::string, lines>;
+
+/// Every glyph rasterized once at one size, so drawing a character is copying rows of pixels
+class GlyphAtlas
+{
+public:
+    explicit GlyphAtlas(int pixel_size) :
+        width{cell_width*pixel_size},
+        height{cell_height*pixel_size},
+        pixels(std::size(font)*width*height, background)
+    {
+        index.fill(0);
+
+        for (auto g = 0u; g != std::size(font); ++g)
+        {
+            index[uint8_t(font[g].c)] = g;
+
+            auto const cell = &pixels[g*width*height];
+            for (auto y = 0; y != 7*pixel_size; ++y)
+            {
+                auto const row = font[g].rows[y/pixel_size];
+                auto const target = cell + (y + pixel_size)*width;
+
+                for (auto x = 0; x != 5*pixel_size; ++x)
+                {
+                    if (row & (0x10 >> (x/pixel_size)))
+                        target[x] = foreground;
+                }
+            }
+        }
+    }
+
+    // Characters not in the font are drawn as spaces
+    void draw(char c, uint32_t* target, int32_t target_width) const
+    {
+        auto const glyph = uint8_t(c) < index.size() ? index[uint8_t(c)] : 0;
+        auto const cell = &pixels[glyph*width*height];
+
+        for (auto y = 0; y != height; ++y)
+        {
+            std::copy_n(cell + y*width, width, target + y*target_width);
+        }
+    }
+
+    int32_t const width;
+    int32_t const height;
+
+private:
+    std::vector<uint32_t> pixels;
+    std::array<uint8_t, 128> index;
+};
+
+auto char_at(std::string const& line, int column) -> char
+{
+    return column < int(line.size()) ? char(toupper(line[column])) : ' ';
+}
+
+// The upper bound of the bucket containing the fraction of samples
+auto percentile(RenderMonitor::Histogram const& histogram, double fraction) -> std::string
+{
+    auto const& bounds = RenderMonitor::Histogram::bounds_ms;
+    auto const total = histogram.total();
+
+    if (!total)
+        return "-";
+
+    uint32_t count = 0;
+    for (auto i = 0u; i != bounds.size(); ++i)
+    {
+        count += histogram.counts[i];
+        if (count >= fraction*total)
+            return "<=" + std::to_string(bounds[i]) + "MS";
+    }
+
+    return ">" + std::to_string(bounds.back()) + "MS";
+}
+
+auto resident_bytes() -> long
+{
+    std::ifstream statm{"/proc/self/statm"};
+    long size = 0;
+    long resident = 0;
+    statm >> size >> resident;
+    return resident*sysconf(_SC_PAGESIZE);
+}
+
+template<typename... Args>
+auto format_line(char const* pattern, Args... args) -> std::string
+{
+    char buffer[columns + 1];
+    snprintf(buffer, sizeof buffer, pattern, args...);
+    return buffer;
+}
+}
+
+struct FrameHud::Self : egmde::FullscreenClient
+{
+    Self(wl_display* display, FullscreenClient& host, RenderMonitor const& render_monitor);
+
+    void draw_screen(SurfaceInfo& info) const override;
+    void on_tick() override;
+
+    void toggle();
+
+    RenderMonitor const& render_monitor;
+    bool visible = false;
+    std::chrono::steady_clock::duration last_update{};
+
+    // An output's HUD, updated in place in a buffer we keep mapped
+    struct Panel
+    {
+        ~Panel() { unmap_shm(pixels, size); }
+
+        wl_surface* surface;
+        wl_buffer* buffer;
+        uint32_t* pixels;
+        size_t size;
+        int32_t width;
+        int32_t scale;
+
+        // The compositor hasn't released the buffer yet, so it mustn't be written
+        bool busy = false;
+
+        Text shown;
+    };
+
+    std::map<Output const*, std::unique_ptr<Panel>> mutable panels;
+
+    // Keyed by the size of a font pixel
+    std::map<int, GlyphAtlas> mutable atlases;
+    auto atlas_for(int32_t scale) const -> GlyphAtlas const&;
+
+    auto text_for(Output const& output) const -> Text;
+
+    // Draws the characters that differ from those shown, damaging their cells. Returns whether any did.
+    auto draw_text(Panel& panel, Text const& text) const -> bool;
+    void present(Panel& panel) const;
+
+    static void buffer_release(void* data, wl_buffer* buffer);
+    static wl_buffer_listener const buffer_listener;
+};
+
+wl_buffer_listener const FrameHud::Self::buffer_listener{&buffer_release};
+
+FrameHud::Self::Self(wl_display* display, FullscreenClient& host, RenderMonitor const& render_monitor) :
+    FullscreenClient(display, &host),
+    render_monitor{render_monitor}
+{
+}
+
+void FrameHud::Self::buffer_release(void* data, wl_buffer* /*buffer*/)
+{
+    static_cast<Panel*>(data)->busy = false;
+}
+
+auto FrameHud::Self::atlas_for(int32_t scale) const -> GlyphAtlas const&
+{
+    auto const pixel_size = 2*std::max(scale, 1);
+    return atlases.try_emplace(pixel_size, pixel_size).first->second;
+}
+
+void FrameHud::Self::toggle()
+{
+    visible = !visible;
+    set_tick_interval(visible ? std::chrono::seconds{1} : std::chrono::seconds{0});
+    redraw();
+
+    if (!visible)
+        atlases.clear();
+}
+
+auto FrameHud::Self::text_for(Output const& output) const -> Text
+{
+    Text text;
+    text[0] = format_line("%dX%d%+d%+d %dHZ",
+        output.width, output.height, output.x, output.y, (output.refresh_mhz + 500)/1000);
+
+    for (auto const& stats : render_monitor.statistics())
+    {
+        if (stats.area.top_left.x.as_int() == output.x && stats.area.top_left.y.as_int() == output.y)
+        {
+            text[1] = format_line("FPS %.1f COMMITS %.1f", stats.frames_per_second, stats.commits_per_second);
+            text[2] = format_line("FRAME    P50%s P99%s",
+                percentile(stats.frame_time, 0.5).c_str(), percentile(stats.frame_time, 0.99).c_str());
+            text[3] = format_line("INTERVAL P50%s P99%s",
+                percentile(stats.frame_interval, 0.5).c_str(), percentile(stats.frame_interval, 0.99).c_str());
+            break;
+        }
+    }
+
+    text[4] = format_line("WINDOWS %ld", long(frame_statistics.window_count()));
+    text[5] = format_line("RSS %.1fMB SHM %.1fMB",
+        resident_bytes()/1048576.0, frame_statistics.internal_client_shm_bytes.load()/1048576.0);
+    text[6] = format_line("HUD UPDATE %.3fMS",
+        std::chrono::duration<double, std::milli>{last_update}.count());
+
+    return text;
+}
+
+auto FrameHud::Self::draw_text(Panel& panel, Text const& text) const -> bool
+{
+    auto const& atlas = atlas_for(panel.scale);
+    bool damaged = false;
+
+    for (auto line = 0; line != lines; ++line)
+    {
+        auto const& now = text[line];
+        auto const& was = panel.shown[line];
+
+        for (auto column = 0; column != columns;)
+        {
+            if (char_at(now, column) == char_at(was, column))
+            {
+                ++column;
+                continue;
+            }
+
+            auto const start = column;
+            for (; column != columns && char_at(now, column) != char_at(was, column); ++column)
+            {
+                atlas.draw(
+                    char_at(now, column),
+                    panel.pixels + line*atlas.height*panel.width + column*atlas.width,
+                    panel.width);
+            }
+
+            // Surface coordinates (the buffer is at the output's scale)
+            wl_surface_damage(
+                panel.surface,
+                start*atlas.width/panel.scale, line*atlas.height/panel.scale,
+                (column - start)*atlas.width/panel.scale, atlas.height/panel.scale);
+            damaged = true;
+        }
+
+        panel.shown[line] = now;
+    }
+
+    return damaged;
+}
+
+void FrameHud::Self::present(Panel& panel) const
+{
+    wl_surface_attach(panel.surface, panel.buffer, 0, 0);
+    wl_surface_commit(panel.surface);
+    panel.busy = true;
+}
+
+void FrameHud::Self::draw_screen(SurfaceInfo& info) const
+{
+    if (!visible)
+    {
+        info.clear_window();
+        panels.erase(info.output);
+        return;
+    }
+
+    if (!info.surface)
+    {
+        info.surface = wl_compositor_create_surface(compositor);
+
+        // We don't handle input, so the compositor shouldn't send us any
+        auto const region = wl_compositor_create_region(compositor);
+        wl_surface_set_input_region(info.surface, region);
+        wl_region_destroy(region);
+    }
+
+    if (!info.shell_surface)
+    {
+        // The window manager recognises the title and puts the HUD over the applications on this output
+        info.shell_surface = wl_shell_get_shell_surface(shell, info.surface);
+        wl_shell_surface_set_title(info.shell_surface, title);
+        wl_shell_surface_set_fullscreen(
+            info.shell_surface,
+            WL_SHELL_SURFACE_FULLSCREEN_METHOD_DEFAULT,
+            0,
+            info.output->output);
+    }
+
+    if (info.buffer)
+    {
+        wl_buffer_destroy(info.buffer);
+    }
+
+    auto const scale = std::max(info.output->scale_factor, 1);
+    auto const& atlas = atlas_for(scale);
+
+    auto panel = std::make_unique<Panel>();
+    panel->surface = info.surface;
+    panel->width = columns*atlas.width;
+    panel->scale = scale;
+
+    auto const height = lines*atlas.height;
+    panel->size = size_t(panel->width)*height*4;
+    {
+        void* pixels;
+        auto const shm_pool = make_shm_pool(panel->size, &pixels);
+        panel->pixels = static_cast<uint32_t*>(pixels);
+
+        info.buffer = wl_shm_pool_create_buffer(
+            shm_pool.get(),
+            0,
+            panel->width, height, panel->width*4,
+            WL_SHM_FORMAT_ARGB8888);
+    }
+
+    panel->buffer = info.buffer;
+    wl_buffer_add_listener(info.buffer, &buffer_listener, panel.get());
+
+    std::fill_n(panel->pixels, size_t(panel->width)*height, background);
+    draw_text(*panel, text_for(*info.output));
+
+    wl_surface_set_buffer_scale(info.surface, scale);
+    wl_surface_damage(info.surface, 0, 0, INT32_MAX, INT32_MAX);
+    present(*panel);
+
+    panels[info.output] = std::move(panel);
+}
+
+void FrameHud::Self::on_tick()
+{
+    auto const started = std::chrono::steady_clock::now();
+
+    // Panels of outputs that have gone are dropped
+    decltype(panels) current;
+    for_each_output([&](Output const& output)
+        {
+            auto const i = panels.find(&output);
+            if (i == panels.end())
+                return;
+
+            auto& panel = *current.insert(panels.extract(i)).position->second;
+
+            // If the compositor still has the buffer we catch up next time
+            if (!panel.busy && draw_text(panel, text_for(output)))
+                present(panel);
+        });
+    panels = std::move(current);
+
+    last_update = std::chrono::steady_clock::now() - started;
+}
+
+FrameHud::FrameHud(RenderMonitor const& render_monitor) :
+    render_monitor{render_monitor}
+{
+}
+
+auto FrameHud::connect(wl_display* display, egmde::FullscreenClient& host)
+-> std::shared_ptr<egmde::FullscreenClient>
+{
+    {
+        std::lock_guard<decltype(mutex)> lock{mutex};
+        if (!enabled)
+            return {};
+    }
+
+    return std::make_shared<Self>(display, host, render_monitor);
+}
+
+void FrameHud::enable(bool enabled)
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    this->enabled = enabled;
+}
+
+auto FrameHud::toggle() -> bool
+{
+    // The client thread owns the surfaces
+    return with_client<Self>([](Self& client) { client.invoke([client=&client] { client->toggle(); }); });
+}
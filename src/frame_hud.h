@@ -0,0 +1,55 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_HUD_H
+#define FRAME_HUD_H
+
+#include "frame_client_host.h"
+
+#include <memory>
+#include <mutex>
+
+class RenderMonitor;
+
+/// An internal client showing a small overlay of frame rate, frame times, windows and memory in the corner of each
+/// output. It is hidden until toggled, and costs nothing (no surfaces or ticks) while hidden.
+class FrameHud : public FrameHostedClient
+{
+public:
+    /// The title of the HUD's windows, so the window manager can place them over the applications
+    static auto constexpr title = "Frame HUD";
+
+    explicit FrameHud(RenderMonitor const& render_monitor);
+
+    // Used in initialization
+    void enable(bool enabled);
+
+    /// Shows or hides the HUD, returning false if it isn't enabled. Safe to call from any thread.
+    auto toggle() -> bool;
+
+private:
+    RenderMonitor const& render_monitor;
+
+    std::mutex mutable mutex;
+    bool enabled = true;
+
+    struct Self;
+
+    auto connect(wl_display* display, egmde::FullscreenClient& host)
+    -> std::shared_ptr<egmde::FullscreenClient> override;
+};
+
+#endif // FRAME_HUD_H
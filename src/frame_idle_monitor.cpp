@@ -0,0 +1,396 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frame_idle_monitor.h"
+#include "frame_render_monitor.h"
+
+#include <mir/compositor/compositor.h>
+#include <mir/display_configuration_controller.h>
+#include <mir/graphics/display.h>
+#include <mir/graphics/display_configuration.h>
+#include <mir/graphics/display_configuration_observer.h>
+#include <mir/input/composite_event_filter.h>
+#include <mir/input/event_filter.h>
+#include <mir/log.h>
+#include <mir/observer_registrar.h>
+#include <mir/server.h>
+#include <mir_toolkit/events/event.h>
+
+#include <boost/throw_exception.hpp>
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <utility>
+#include <system_error>
+
+using namespace std::chrono;
+
+struct FrameIdleMonitor::InputFilter : mir::input::EventFilter
+{
+    explicit InputFilter(FrameIdleMonitor& self) : self{self} {}
+
+    bool handle(MirEvent const& event) override
+    {
+        return mir_event_get_type(&event) == mir_event_type_input && self.on_input();
+    }
+
+    FrameIdleMonitor& self;
+};
+
+struct FrameIdleMonitor::ConfigurationObserver : mir::graphics::DisplayConfigurationObserver
+{
+    using Configuration = std::shared_ptr<mir::graphics::DisplayConfiguration const>;
+
+    explicit ConfigurationObserver(FrameIdleMonitor& self) : self{self} {}
+
+    void configuration_applied(Configuration const& config) override { self.on_configuration(config); }
+
+    void configuration_failed(Configuration const&, std::exception const&) override { self.on_configuration({}); }
+
+    void initial_configuration(Configuration const&) override {}
+    void base_configuration_updated(Configuration const&) override {}
+    void session_configuration_applied(
+        std::shared_ptr<mir::scene::Session> const&,
+        std::shared_ptr<mir::graphics::DisplayConfiguration> const&) override {}
+    void session_configuration_removed(std::shared_ptr<mir::scene::Session> const&) override {}
+    void catastrophic_configuration_error(Configuration const&, std::exception const&) override {}
+    void configuration_updated_for_session(
+        std::shared_ptr<mir::scene::Session> const&, Configuration const&) override {}
+
+    FrameIdleMonitor& self;
+};
+
+FrameIdleMonitor::FrameIdleMonitor(miral::MirRunner& runner, RenderMonitor const& render_monitor) :
+    runner{runner},
+    render_monitor{render_monitor},
+    timer{timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)},
+    last_input{Clock::now().time_since_epoch().count()}
+{
+    if (timer < 0)
+    {
+        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to create timer"}));
+    }
+
+    runner.add_start_callback([this] { start(); });
+    runner.add_stop_callback([this]
+        {
+            timer_handle.reset();
+            input_filter.reset();
+            configuration_observer.reset();
+            display_controller.reset();
+            display.reset();
+            compositor.reset();
+        });
+}
+
+FrameIdleMonitor::~FrameIdleMonitor() = default;
+
+void FrameIdleMonitor::timeout(int seconds)
+{
+    idle_timeout = std::chrono::seconds{std::max(seconds, 0)};
+}
+
+void FrameIdleMonitor::power_mode(std::string const& option)
+{
+    if (option == "off")
+    {
+        idle_power_mode = mir_power_mode_off;
+    }
+    else if (option == "suspend")
+    {
+        idle_power_mode = mir_power_mode_suspend;
+    }
+    else if (option == "standby")
+    {
+        idle_power_mode = mir_power_mode_standby;
+    }
+    else
+    {
+        mir::log_warning("Unknown idle power mode '%s' (expected off, suspend or standby)", option.c_str());
+    }
+}
+
+void FrameIdleMonitor::operator()(mir::Server& server)
+{
+    server.add_init_callback([this, &server]
+        {
+            if (idle_timeout == seconds::zero())
+                return;
+
+            display_controller = server.the_display_configuration_controller();
+            display = server.the_display();
+            compositor = server.the_compositor();
+
+            // The composite filter and the registrar only keep weak references, so we own these
+            input_filter = std::make_shared<InputFilter>(*this);
+            server.the_composite_event_filter()->prepend(input_filter);
+
+            configuration_observer = std::make_shared<ConfigurationObserver>(*this);
+            server.the_display_configuration_observer_registrar()->register_interest(configuration_observer);
+        });
+}
+
+void FrameIdleMonitor::on_wake(std::function<void()> handler)
+{
+    wake_handlers.push_back(std::move(handler));
+}
+
+void FrameIdleMonitor::start()
+{
+    if (idle_timeout == seconds::zero())
+        return;
+
+    last_input = Clock::now().time_since_epoch().count();
+    timer_handle = runner.register_fd_handler(timer, [this](int fd)
+        {
+            uint64_t expirations;
+            if (read(fd, &expirations, sizeof expirations) == sizeof expirations)
+                on_timer();
+        });
+
+    arm(idle_timeout);
+}
+
+void FrameIdleMonitor::arm(Clock::duration delay)
+{
+    // A zero it_value disarms the timer, so fire at least a nanosecond from now
+    auto const delay_ns = std::max<nanoseconds::rep>(duration_cast<nanoseconds>(delay).count(), 1);
+
+    itimerspec const spec{{0, 0}, {time_t(delay_ns / 1000000000), long(delay_ns % 1000000000)}};
+    timerfd_settime(timer, 0, &spec, nullptr);
+}
+
+// Called on the input thread, returns true to swallow the event
+auto FrameIdleMonitor::on_input() -> bool
+{
+    auto const now = Clock::now().time_since_epoch().count();
+    last_input = now;
+
+    if (!powered_down)
+        return false;
+
+    // Only the first event of a wake-up starts the latency measurement and needs to poke the main loop
+    Clock::rep expected{0};
+    if (wake_requested.compare_exchange_strong(expected, now))
+    {
+        arm(nanoseconds{1});
+    }
+
+    return true;
+}
+
+// Called on the thread applying the configuration, which then restarts the compositor: we act on the main loop
+void FrameIdleMonitor::on_configuration(std::shared_ptr<mir::graphics::DisplayConfiguration const> const& configuration)
+{
+    {
+        std::lock_guard<decltype(applied_mutex)> lock{applied_mutex};
+        configuration_changed = true;
+        applied = configuration;
+        applied_at = Clock::now();
+    }
+
+    arm(nanoseconds{1});
+}
+
+void FrameIdleMonitor::on_timer()
+{
+    auto const now = Clock::now();
+
+    bool changed;
+    std::shared_ptr<mir::graphics::DisplayConfiguration const> configuration;
+    Clock::time_point configured_at;
+    {
+        std::lock_guard<decltype(applied_mutex)> lock{applied_mutex};
+        changed = std::exchange(configuration_changed, false);
+        configuration = std::move(applied);
+        configured_at = applied_at;
+    }
+
+    switch (power)
+    {
+    case Power::on:
+        break;
+
+    case Power::powering_down:
+        if (changed && !configuration)
+        {
+            mir::log_warning("Failed to power down idle outputs");
+            powered_down = false;
+            power = Power::on;
+            break;
+        }
+
+        if (configuration && our_outputs_are(*configuration, false))
+        {
+            power = Power::off;
+
+            // Nothing will change on screen until we wake, so there's no point compositing. (The display changer
+            // restarts the compositor after applying a configuration, so this has to wait until it has.)
+            compositor->stop();
+        }
+
+        if (wake_requested.load())
+            wake();
+        return;
+
+    case Power::off:
+        // Something else (e.g. a hotplug) changed the configuration, which restarted the compositor
+        if (changed)
+            compositor->stop();
+
+        if (wake_requested.load())
+            wake();
+        return;
+
+    case Power::waking:
+        if (changed && !configuration)
+        {
+            mir::log_warning("Failed to power up outputs after idling");
+            woken(now);
+        }
+        else if (configuration && our_outputs_are(*configuration, true))
+        {
+            woken(configured_at);
+        }
+        return;
+    }
+
+    auto const last_activity = std::max(Clock::time_point{Clock::duration{last_input.load()}}, render_monitor.last_commit());
+    auto const idle_for = now - last_activity;
+
+    if (idle_for < idle_timeout)
+    {
+        arm(idle_timeout - idle_for);
+        return;
+    }
+
+    mir::log_info("No input or client activity for %ds, powering down outputs", int(idle_timeout.count()));
+    power_down();
+
+    // Input may have arrived while we were powering down
+    if (wake_requested.load() || Clock::time_point{Clock::duration{last_input.load()}} > now)
+    {
+        Clock::rep expected{0};
+        wake_requested.compare_exchange_strong(expected, Clock::now().time_since_epoch().count());
+        arm(nanoseconds{1});
+    }
+}
+
+void FrameIdleMonitor::power_down()
+{
+    powered_down = true;
+
+    if (set_power_mode(idle_power_mode))
+    {
+        power = Power::powering_down;
+    }
+    else
+    {
+        // Every output was already off, so there's no configuration to wait for
+        power = Power::off;
+        compositor->stop();
+    }
+}
+
+void FrameIdleMonitor::wake()
+{
+    wake_started = Clock::now();
+
+    if (set_power_mode(mir_power_mode_on))
+    {
+        power = Power::waking;
+    }
+    else
+    {
+        woken(wake_started);
+    }
+}
+
+void FrameIdleMonitor::woken(Clock::time_point applied_at)
+{
+    // Normally already restarted by the display changer, but not if there was nothing to configure
+    compositor->start();
+
+    auto const requested = Clock::time_point{Clock::duration{wake_requested.load()}};
+    mir::log_info(
+        "Outputs woken by input: %.1fms to main loop, %.1fms to outputs on",
+        duration<double, std::milli>(wake_started - requested).count(),
+        duration<double, std::milli>(applied_at - requested).count());
+
+    power = Power::on;
+    powered_down = false;
+    wake_requested = 0;
+
+    for (auto const& handler : wake_handlers)
+        handler();
+
+    arm(idle_timeout);
+}
+
+// Returns whether any output's power mode was changed
+auto FrameIdleMonitor::set_power_mode(MirPowerMode mode) -> bool
+{
+    std::shared_ptr<mir::graphics::DisplayConfiguration> const configuration = display->configuration();
+
+    // Leave outputs that were already off (e.g. by FrameOutputPowerSaver) as we found them
+    bool const waking = mode == mir_power_mode_on;
+    if (!waking)
+        outputs_on.clear();
+
+    bool changed = false;
+    configuration->for_each_output([&](mir::graphics::UserDisplayConfigurationOutput& output)
+        {
+            if (!output.used)
+                return;
+
+            auto const id = output.id.as_value();
+            if (waking)
+            {
+                // Even if it's still on: powering it down may be queued behind this configuration
+                if (std::find(begin(outputs_on), end(outputs_on), id) != end(outputs_on))
+                {
+                    output.power_mode = mode;
+                    changed = true;
+                }
+            }
+            else if (output.power_mode == mir_power_mode_on)
+            {
+                outputs_on.push_back(id);
+                output.power_mode = mode;
+                changed = true;
+            }
+        });
+
+    if (changed)
+        display_controller->set_base_configuration(configuration);
+
+    return changed;
+}
+
+auto FrameIdleMonitor::our_outputs_are(mir::graphics::DisplayConfiguration const& configuration, bool on) const -> bool
+{
+    bool result = true;
+    configuration.for_each_output([&](mir::graphics::DisplayConfigurationOutput const& output)
+        {
+            if (std::find(begin(outputs_on), end(outputs_on), output.id.as_value()) != end(outputs_on) &&
+                (output.power_mode == mir_power_mode_on) != on)
+            {
+                result = false;
+            }
+        });
+    return result;
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_IDLE_MONITOR_H
+#define FRAME_IDLE_MONITOR_H
+
+#include <miral/runner.h>
+#include <mir/fd.h>
+#include <mir_toolkit/common.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mir
+{
+class DisplayConfigurationController;
+class Server;
+namespace compositor { class Compositor; }
+namespace graphics { class Display; class DisplayConfiguration; }
+}
+
+class RenderMonitor;
+
+/// Powers down the outputs once there has been no input and no client commits for the timeout, and stops the
+/// compositor while they are off. The first input event wakes the outputs (and is not delivered to clients).
+class FrameIdleMonitor
+{
+public:
+    FrameIdleMonitor(miral::MirRunner& runner, RenderMonitor const& render_monitor);
+    ~FrameIdleMonitor();
+
+    // Used in initialization. A timeout of 0 disables power management.
+    void timeout(int seconds);
+    void power_mode(std::string const& option);
+
+    void operator()(mir::Server& server);
+
+    /// Whether the outputs are (being) powered down for idleness. Others shouldn't power outputs up meanwhile.
+    auto idle() const -> bool { return powered_down; }
+
+    /// Used in initialization: called on the main loop once the outputs are back on after being idle
+    void on_wake(std::function<void()> handler);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct InputFilter;
+    struct ConfigurationObserver;
+
+    // Main loop only. Changes to the outputs' power take effect when the display configuration is applied.
+    enum class Power { on, powering_down, off, waking };
+
+    void start();
+    void on_timer();
+    void arm(Clock::duration delay);
+    void power_down();
+    void wake();
+    void woken(Clock::time_point applied_at);
+    auto set_power_mode(MirPowerMode mode) -> bool;
+    auto our_outputs_are(mir::graphics::DisplayConfiguration const& configuration, bool on) const -> bool;
+    auto on_input() -> bool;
+    void on_configuration(std::shared_ptr<mir::graphics::DisplayConfiguration const> const& configuration);
+
+    miral::MirRunner& runner;
+    RenderMonitor const& render_monitor;
+
+    std::chrono::seconds idle_timeout{0};
+    MirPowerMode idle_power_mode = mir_power_mode_off;
+
+    std::shared_ptr<InputFilter> input_filter;
+    std::shared_ptr<ConfigurationObserver> configuration_observer;
+    std::shared_ptr<mir::DisplayConfigurationController> display_controller;
+    std::shared_ptr<mir::graphics::Display> display;
+    std::shared_ptr<mir::compositor::Compositor> compositor;
+
+    mir::Fd const timer;
+    std::unique_ptr<miral::FdHandle> timer_handle;
+
+    // Shared between the input thread and the main loop
+    std::atomic<Clock::rep> last_input;
+    std::atomic<Clock::rep> wake_requested{0};
+    std::atomic<bool> powered_down{false};
+
+    // Shared between the display configuration observer and the main loop: the last configuration applied (or
+    // that failed to apply, when null) since the main loop looked
+    std::mutex applied_mutex;
+    bool configuration_changed = false;
+    std::shared_ptr<mir::graphics::DisplayConfiguration const> applied;
+    Clock::time_point applied_at;
+
+    // Main loop only: the outputs that were on when we powered down, and so should be restored on waking
+    Power power = Power::on;
+    std::vector<int> outputs_on;
+    Clock::time_point wake_started;
+    std::vector<std::function<void()>> wake_handlers;
+};
+
+#endif // FRAME_IDLE_MONITOR_H
@@ -0,0 +1,310 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frame_image_writer.h"
+
+#include <boost/throw_exception.hpp>
+
+#include <unistd.h>
+#include <zlib.h>
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+namespace
+{
+using File = std::unique_ptr<FILE, decltype(&fclose)>;
+
+auto row_of(ImageView const& image, int32_t y) -> uint8_t const*
+{
+    auto const row = image.y_invert ? image.height - 1 - y : y;
+    return static_cast<uint8_t const*>(image.pixels) + row * image.stride;
+}
+
+void write_bytes(FILE* file, void const* data, size_t size)
+{
+    if (fwrite(data, 1, size, file) != size)
+    {
+        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to write image"}));
+    }
+}
+
+void write_be32(FILE* file, uint32_t value)
+{
+    uint8_t const bytes[] = {uint8_t(value >> 24), uint8_t(value >> 16), uint8_t(value >> 8), uint8_t(value)};
+    write_bytes(file, bytes, sizeof bytes);
+}
+
+// Converts a row of shm pixels to packed RGB
+void to_rgb(uint8_t const* in, int32_t width, uint8_t* out)
+{
+    for (auto const end = in + 4*width; in != end; in += 4, out += 3)
+    {
+        out[0] = in[2];
+        out[1] = in[1];
+        out[2] = in[0];
+    }
+}
+
+void write_ppm(FILE* file, ImageView const& image)
+{
+    fprintf(file, "P6\n%d %d\n255\n", image.width, image.height);
+
+    std::vector<uint8_t> rgb(3*image.width);
+    for (int32_t y = 0; y != image.height; ++y)
+    {
+        to_rgb(row_of(image, y), image.width, rgb.data());
+        write_bytes(file, rgb.data(), rgb.size());
+    }
+}
+
+void write_png_chunk(FILE* file, char const type[4], uint8_t const* data, uint32_t size)
+{
+    write_be32(file, size);
+    write_bytes(file, type, 4);
+    write_bytes(file, data, size);
+
+    auto crc = crc32(0, reinterpret_cast<Bytef const*>(type), 4);
+    if (size)
+        crc = crc32(crc, data, size);   // Note: crc32() treats a null buffer as a request for the initial value
+    write_be32(file, crc);
+}
+
+void write_png(FILE* file, ImageView const& image)
+{
+    static uint8_t const signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    write_bytes(file, signature, sizeof signature);
+
+    uint8_t const header[] = {
+        uint8_t(image.width >> 24), uint8_t(image.width >> 16), uint8_t(image.width >> 8), uint8_t(image.width),
+        uint8_t(image.height >> 24), uint8_t(image.height >> 16), uint8_t(image.height >> 8), uint8_t(image.height),
+        8,  // bit depth
+        2,  // colour type: RGB
+        0,  // compression: deflate
+        0,  // filter method
+        0,  // no interlace
+    };
+    write_png_chunk(file, "IHDR", header, sizeof header);
+
+    z_stream stream{};
+    if (deflateInit(&stream, Z_BEST_SPEED) != Z_OK)
+    {
+        BOOST_THROW_EXCEPTION((std::runtime_error{"Failed to initialize zlib"}));
+    }
+    std::unique_ptr<z_stream, decltype(&deflateEnd)> const cleanup{&stream, &deflateEnd};
+
+    // Each row is prefixed by its filter type. We use "none" as filtering costs more time than it saves.
+    std::vector<uint8_t> row(1 + 3*image.width);
+    std::vector<uint8_t> compressed(256*1024);
+
+    auto const deflate_into_chunks = [&](int flush)
+        {
+            do
+            {
+                stream.next_out = compressed.data();
+                stream.avail_out = compressed.size();
+                deflate(&stream, flush);
+
+                if (auto const size = compressed.size() - stream.avail_out)
+                    write_png_chunk(file, "IDAT", compressed.data(), size);
+            }
+            while (stream.avail_out == 0);
+        };
+
+    for (int32_t y = 0; y != image.height; ++y)
+    {
+        row[0] = 0;
+        to_rgb(row_of(image, y), image.width, row.data() + 1);
+
+        stream.next_in = row.data();
+        stream.avail_in = row.size();
+        deflate_into_chunks(Z_NO_FLUSH);
+    }
+
+    deflate_into_chunks(Z_FINISH);
+    write_png_chunk(file, "IEND", nullptr, 0);
+}
+
+// See https://qoiformat.org/qoi-specification.pdf
+void write_qoi(FILE* file, ImageView const& image)
+{
+    struct Pixel { uint8_t r, g, b, a; };
+
+    write_bytes(file, "qoif", 4);
+    write_be32(file, image.width);
+    write_be32(file, image.height);
+    uint8_t const channels_and_colourspace[] = {3, 0};
+    write_bytes(file, channels_and_colourspace, sizeof channels_and_colourspace);
+
+    Pixel index[64]{};
+    Pixel previous{0, 0, 0, 255};
+    int run = 0;
+
+    std::vector<uint8_t> out;
+    out.reserve(4*image.width + 8);
+
+    for (int32_t y = 0; y != image.height; ++y)
+    {
+        auto in = row_of(image, y);
+        for (auto const end = in + 4*image.width; in != end; in += 4)
+        {
+            Pixel const pixel{in[2], in[1], in[0], 255};
+
+            if (memcmp(&pixel, &previous, sizeof pixel) == 0)
+            {
+                if (++run == 62)
+                {
+                    out.push_back(0xc0 | (run - 1));
+                    run = 0;
+                }
+                continue;
+            }
+
+            if (run)
+            {
+                out.push_back(0xc0 | (run - 1));
+                run = 0;
+            }
+
+            auto const hash = (pixel.r*3 + pixel.g*5 + pixel.b*7 + pixel.a*11) % 64;
+
+            if (memcmp(&index[hash], &pixel, sizeof pixel) == 0)
+            {
+                out.push_back(hash);
+            }
+            else
+            {
+                index[hash] = pixel;
+
+                int8_t const dr = pixel.r - previous.r;
+                int8_t const dg = pixel.g - previous.g;
+                int8_t const db = pixel.b - previous.b;
+                int8_t const dr_dg = dr - dg;
+                int8_t const db_dg = db - dg;
+
+                if (-2 <= dr && dr <= 1 && -2 <= dg && dg <= 1 && -2 <= db && db <= 1)
+                {
+                    out.push_back(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                }
+                else if (-32 <= dg && dg <= 31 && -8 <= dr_dg && dr_dg <= 7 && -8 <= db_dg && db_dg <= 7)
+                {
+                    out.push_back(0x80 | (dg + 32));
+                    out.push_back((dr_dg + 8) << 4 | (db_dg + 8));
+                }
+                else
+                {
+                    out.insert(out.end(), {0xfe, pixel.r, pixel.g, pixel.b});
+                }
+            }
+
+            previous = pixel;
+        }
+
+        write_bytes(file, out.data(), out.size());
+        out.clear();
+    }
+
+    if (run)
+    {
+        out.push_back(0xc0 | (run - 1));
+    }
+
+    out.insert(out.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+    write_bytes(file, out.data(), out.size());
+}
+}
+
+auto image_format_from(std::string const& name) -> ImageFormat
+{
+    if (name == "png")
+        return ImageFormat::png;
+    if (name == "qoi")
+        return ImageFormat::qoi;
+    if (name == "ppm")
+        return ImageFormat::ppm;
+
+    BOOST_THROW_EXCEPTION((std::runtime_error{"Unknown image format: " + name}));
+}
+
+auto file_extension_of(ImageFormat format) -> char const*
+{
+    switch (format)
+    {
+    case ImageFormat::png:
+        return "png";
+    case ImageFormat::qoi:
+        return "qoi";
+    case ImageFormat::ppm:
+        return "ppm";
+    }
+
+    return "";
+}
+
+void write_image(std::string const& path, ImageFormat format, ImageView const& image)
+{
+    auto const temporary = path + ".part";
+
+    try
+    {
+        {
+            File const file{fopen(temporary.c_str(), "we"), &fclose};
+
+            if (!file)
+            {
+                BOOST_THROW_EXCEPTION(
+                    (std::system_error{errno, std::system_category(), "Failed to open " + temporary}));
+            }
+
+            // Our writes are row sized, let stdio batch them into something larger
+            setvbuf(file.get(), nullptr, _IOFBF, 1024*1024);
+
+            switch (format)
+            {
+            case ImageFormat::png:
+                write_png(file.get(), image);
+                break;
+            case ImageFormat::qoi:
+                write_qoi(file.get(), image);
+                break;
+            case ImageFormat::ppm:
+                write_ppm(file.get(), image);
+                break;
+            }
+
+            if (fflush(file.get()) != 0)
+            {
+                BOOST_THROW_EXCEPTION(
+                    (std::system_error{errno, std::system_category(), "Failed to write " + temporary}));
+            }
+        }
+
+        if (rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to rename " + temporary}));
+        }
+    }
+    catch (...)
+    {
+        // Don't leave a partial image in the screenshot directory
+        unlink(temporary.c_str());
+        throw;
+    }
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_IMAGE_WRITER_H
+#define FRAME_IMAGE_WRITER_H
+
+#include <cstdint>
+#include <string>
+
+/// Pixels in wl_shm ARGB8888/XRGB8888 layout (i.e. B, G, R, X bytes on little-endian)
+struct ImageView
+{
+    void const* pixels;
+    int32_t width;
+    int32_t height;
+    int32_t stride;
+    bool y_invert;
+};
+
+enum class ImageFormat
+{
+    png,    // PNG with the fastest zlib compression level
+    qoi,    // "Quite OK Image" format, fast lossless compression
+    ppm,    // Uncompressed binary PPM
+};
+
+/// Interprets a format option, throwing std::runtime_error for unknown formats
+auto image_format_from(std::string const& name) -> ImageFormat;
+
+auto file_extension_of(ImageFormat format) -> char const*;
+
+/// Writes the image to path (via a temporary file that is renamed on success)
+void write_image(std::string const& path, ImageFormat format, ImageView const& image);
+
+#endif // FRAME_IMAGE_WRITER_H
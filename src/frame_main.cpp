@@ -17,6 +17,20 @@
  */
 
 #include "frame_authorization.h"
+#include "frame_client_host.h"
+#include "frame_config_watcher.h"
+#include "frame_hud.h"
+#include "frame_idle_monitor.h"
+#include "frame_output_names.h"
+#include "frame_output_power_saver.h"
+#include "frame_render_monitor.h"
+#include "frame_screenshot.h"
+#include "frame_settle_timer.h"
+#include "frame_standby_apps.h"
+#include "frame_statistics.h"
+#include "frame_thread_policy.h"
+#include "frame_thumbnails.h"
+#include "frame_trace_recorder.h"
 #include "frame_window_manager.h"
 #include "egwallpaper.h"
 
@@ -28,6 +42,10 @@
 #include <miral/set_window_management_policy.h>
 #include <miral/wayland_extensions.h>
 
+#include <mir/server.h>
+
+#include <csignal>
+
 int main(int argc, char const* argv[])
 {
     using namespace miral;
@@ -37,8 +55,48 @@ int main(int argc, char const* argv[])
     WaylandExtensions wayland_extensions;
     init_authorization(wayland_extensions, auth_model);
 
+    // The internal clients share a connection and thread
+    FrameClientHost client_host;
+    runner.add_stop_callback([&] { client_host.stop(); });
+
+    // Background work in the internal clients shouldn't compete with compositing
+    FrameThreadPolicy client_threads{"internal client"};
+    client_host.on_client_thread([&] { client_threads.apply(); });
+
     egmde::Wallpaper wallpaper;
-    runner.add_stop_callback([&] { wallpaper.stop(); });
+    client_host.add(wallpaper);
+
+    auto const wallpaper_top_default = "0x7f7f7f";
+    auto const wallpaper_bottom_default = "0x1f1f1f";
+
+    FrameConfigWatcher config_watcher{runner};
+    config_watcher.add_live_option("wallpaper-top", wallpaper_top_default, [&](auto& option) { wallpaper.top(option); });
+    config_watcher.add_live_option("wallpaper-bottom", wallpaper_bottom_default, [&](auto& option) { wallpaper.bottom(option); });
+
+    FrameScreenshot screenshot;
+    client_host.add(screenshot);
+    runner.register_signal_handler({SIGUSR1}, [&](int) { screenshot.capture(); });
+
+    FrameThumbnails thumbnails;
+    client_host.add(thumbnails);
+
+    auto const render_monitor = std::make_shared<RenderMonitor>();
+
+    FrameThreadPolicy compositor_threads{"compositor"};
+    render_monitor->on_compositor_thread([&] { compositor_threads.apply(); });
+    StatisticsSocket statistics_socket{runner, *render_monitor};
+    FrameIdleMonitor idle_monitor{runner, *render_monitor};
+    FrameOutputPowerSaver output_power_saver{runner, idle_monitor};
+
+    FrameHud hud{*render_monitor};
+    client_host.add(hud);
+
+    FrameSettleTimer zone_settle_timer{runner};
+    FrameStandbyApps standby_apps;
+    FrameTraceRecorder wm_trace{runner};
+    config_watcher.add_live_option("active-app", "", [&](auto& option) { standby_apps.activate(option); });
+    FrameWindowManagerOptions window_manager_options;
+    FrameOutputNames output_names{window_manager_options.output_rules};
 
     return runner.run_with(
         {
@@ -46,11 +104,84 @@ int main(int argc, char const* argv[])
             display_config,
             display_config.layout_option(),
             CommandLineOption{[&](auto& option) { wallpaper.top(option);},
-                              "wallpaper-top",    "Colour of wallpaper RGB", "0x7f7f7f"},
+                              "wallpaper-top",    "Colour of wallpaper RGB", wallpaper_top_default},
             CommandLineOption{[&](auto& option) { wallpaper.bottom(option);},
-                              "wallpaper-bottom", "Colour of wallpaper RGB", "0x1f1f1f"},
-            StartupInternalClient{std::ref(wallpaper)},
-            set_window_management_policy<FrameWindowManagerPolicy>(),
+                              "wallpaper-bottom", "Colour of wallpaper RGB", wallpaper_bottom_default},
+            CommandLineOption{[&](auto& option) { wallpaper.playlist(option);},
+                              "wallpaper-playlist", "Comma separated top:bottom RGB colour pairs to cycle the wallpaper through", ""},
+            CommandLineOption{[&](int option) { wallpaper.playlist_period(option);},
+                              "wallpaper-playlist-period", "Seconds each wallpaper playlist entry is shown", 60},
+            CommandLineOption{[&](int option) { wallpaper.transition_frames(option);},
+                              "wallpaper-transition-frames", "Frames in the cross-fade between wallpaper playlist entries", 15},
+            CommandLineOption{[&](int option) { wallpaper.animation_rate(option);},
+                              "wallpaper-animation-fps", "Frame rate of wallpaper playlist transitions", 15},
+            CommandLineOption{[&](bool option) { wallpaper.span(option);},
+                              "wallpaper-span", "Stretch the wallpaper across all outputs (e.g. for a video wall)", false},
+            CommandLineOption{[&](int option) { wallpaper.colour_depth(option);},
+                              "wallpaper-colour-depth", "Colour depth of the panels, 16 allows a dithered RGB565 wallpaper [16|24]", 24},
+            CommandLineOption{[&](auto& option) { wallpaper.cache_directory(option);},
+                              "wallpaper-cache-directory", "Directory for rendered wallpapers, or none [$SNAP_DATA/wallpaper-cache]", ""},
+            CommandLineOption{[&](auto& option) { screenshot.directory(option);},
+                              "screenshot-directory", "Directory for screenshots taken on SIGUSR1 [$SNAP_USER_COMMON]", ""},
+            CommandLineOption{[&](auto& option) { screenshot.format(option);},
+                              "screenshot-format", "Image format for screenshots [png|qoi|ppm]", "png"},
+            CommandLineOption{[&](int option) { thumbnails.interval(option);},
+                              "thumbnail-interval", "Seconds between proof-of-play thumbnails of changed outputs (0 to disable)", 0},
+            CommandLineOption{[&](int option) { thumbnails.size(option);},
+                              "thumbnail-size", "Maximum width and height of thumbnails", 256},
+            CommandLineOption{[&](int option) { thumbnails.slots(option);},
+                              "thumbnail-slots", "Number of thumbnails kept in the ring file", 8},
+            CommandLineOption{[&](auto& option) { thumbnails.file(option);},
+                              "thumbnail-file", "Memory mapped ring file for thumbnails [$XDG_RUNTIME_DIR/frame-thumbnails]", ""},
+            StartupInternalClient{std::ref(client_host)},
+            [&](mir::Server& server) { server.override_the_compositor_report([&] { return render_monitor; }); },
+            CommandLineOption{[&](int option) { render_monitor->set_drop_threshold(std::chrono::seconds{option});},
+                              "frame-rate-drop-seconds", "Log outputs animating below their refresh rate for this long", 5},
+            CommandLineOption{[&](auto& option) { statistics_socket.path(option);},
+                              "statistics-socket", "Unix socket serving runtime statistics (relative to $XDG_RUNTIME_DIR)", ""},
+            CommandLineOption{[&](int option) { idle_monitor.timeout(option);},
+                              "idle-timeout", "Seconds without input or client activity before powering down outputs (0 to disable)", 0},
+            CommandLineOption{[&](auto& option) { idle_monitor.power_mode(option);},
+                              "idle-power-mode", "Power mode for idle outputs [off|suspend|standby]", "off"},
+            std::ref(idle_monitor),
+            CommandLineOption{[&](int option) { output_power_saver.timeout(option);},
+                              "unused-output-timeout", "Seconds an output may show only the wallpaper before powering it down (0 to disable)", 0},
+            std::ref(output_power_saver),
+            CommandLineOption{[&](auto& option) { compositor_threads.policy(option);},
+                              "compositor-sched-policy", "Scheduling of compositor and input threads [other|batch|idle|fifo:<priority>|rr:<priority>]", ""},
+            CommandLineOption{[&](int option) { compositor_threads.nice(option);},
+                              "compositor-nice", "Niceness of compositor and input threads", 0},
+            CommandLineOption{[&](auto& option) { compositor_threads.cpus(option);},
+                              "compositor-cpus", "CPUs for compositor and input threads (e.g. 2-3)", ""},
+            std::ref(compositor_threads),
+            CommandLineOption{[&](auto& option) { client_threads.policy(option);},
+                              "client-sched-policy", "Scheduling of internal client threads [other|batch|idle|fifo:<priority>|rr:<priority>]", "batch"},
+            CommandLineOption{[&](int option) { client_threads.nice(option);},
+                              "client-nice", "Niceness of internal client threads", 10},
+            CommandLineOption{[&](auto& option) { client_threads.cpus(option);},
+                              "client-cpus", "CPUs for internal client threads (e.g. 0-1)", ""},
+            CommandLineOption{[&](bool option) { hud.enable(option);},
+                              "hud-hotkey", "Allow Ctrl+Alt+H to toggle a performance HUD over the applications", true},
+            CommandLineOption{[&](int option) { zone_settle_timer.settle_time(option);},
+                              "zone-settle-ms", "Milliseconds application zones must be unchanged before fullscreen windows are resized (0 for immediately)", 100},
+            CommandLineOption{[&](bool option) { window_manager_options.osk_overlay = option;},
+                              "osk-overlay", "Show the on-screen keyboard over fullscreen applications instead of resizing them", false},
+            CommandLineOption{[&](int option) { window_manager_options.modify_rate_limit = option;},
+                              "modify-rate-limit", "Requests a second each window may make that don't change its state, position or size (0 for no limit)", 10},
+            CommandLineOption{[&](bool option) { window_manager_options.hide_occluded = option;},
+                              "hide-occluded-windows", "Hide fullscreen windows covered by the active fullscreen window so they stop rendering", false},
+            CommandLineOption{[&](auto& option) { window_manager_options.output_rules = parse_output_rules(option);},
+                              "output-rules", "Comma separated <app-id|snap|pid>:<value>=<output> rules placing applications on outputs (e.g. app-id:org.example.menu=HDMI-A-1)", ""},
+            std::ref(output_names),
+            CommandLineOption{[&](auto& option) { standby_apps.apps(option);},
+                              "standby-apps", "Comma separated app ids whose fullscreen windows wait below the active one", ""},
+            CommandLineOption{[&](auto& option) { standby_apps.activate(option);},
+                              "active-app", "The standby app to show (can be changed in the config file at runtime)", ""},
+            CommandLineOption{[&](auto& option) { wm_trace.file(option);},
+                              "wm-trace-file", "Record window management inputs and timings to this file (for wm-trace-report)", ""},
+            set_window_management_policy<FrameWindowManagerPolicy>(
+                *render_monitor, hud, zone_settle_timer, output_power_saver, standby_apps, wm_trace, output_names,
+                window_manager_options),
             Keymap{}
         });
 }
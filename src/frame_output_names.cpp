@@ -0,0 +1,129 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "frame_output_names.h"
+#include "frame_window_manager.h"
+
+#include <mir/graphics/display.h>
+#include <mir/graphics/display_configuration.h>
+#include <mir/graphics/display_configuration_observer.h>
+#include <mir/log.h>
+#include <mir/observer_registrar.h>
+#include <mir/server.h>
+
+#include <iterator>
+
+namespace
+{
+// The display layout's name for each MirOutputType
+char const* const type_names[] = {
+    "unknown", "VGA", "DVI-I", "DVI-D", "DVI-A", "Composite", "S-Video", "LVDS", "Component", "9-pin-DIN",
+    "DisplayPort", "HDMI-A", "HDMI-B", "TV", "eDP", "Virtual", "DSI", "DPI"
+};
+
+auto type_name(mir::graphics::DisplayConfigurationOutputType type) -> char const*
+{
+    auto const index = static_cast<size_t>(type);
+    return index < std::size(type_names) ? type_names[index] : type_names[0];
+}
+}
+
+struct FrameOutputNames::ConfigurationObserver : mir::graphics::DisplayConfigurationObserver
+{
+    using Configuration = std::shared_ptr<mir::graphics::DisplayConfiguration const>;
+
+    explicit ConfigurationObserver(FrameOutputNames& self) : self{self} {}
+
+    // Connectors can come and go (e.g. with DisplayPort MST hubs)
+    void initial_configuration(Configuration const& config) override { self.update(*config); }
+    void configuration_applied(Configuration const& config) override { self.update(*config); }
+
+    void base_configuration_updated(Configuration const&) override {}
+    void session_configuration_applied(
+        std::shared_ptr<mir::scene::Session> const&,
+        std::shared_ptr<mir::graphics::DisplayConfiguration> const&) override {}
+    void session_configuration_removed(std::shared_ptr<mir::scene::Session> const&) override {}
+    void configuration_failed(Configuration const&, std::exception const&) override {}
+    void catastrophic_configuration_error(Configuration const&, std::exception const&) override {}
+    void configuration_updated_for_session(
+        std::shared_ptr<mir::scene::Session> const&, Configuration const&) override {}
+
+    FrameOutputNames& self;
+};
+
+FrameOutputNames::FrameOutputNames(std::vector<FrameOutputRule> const& rules) :
+    rules{rules}
+{
+}
+
+FrameOutputNames::~FrameOutputNames() = default;
+
+void FrameOutputNames::operator()(mir::Server& server)
+{
+    server.add_init_callback([this, &server]
+        {
+            update(*server.the_display()->configuration());
+
+            // The registrar only keeps a weak reference, so we own this
+            configuration_observer = std::make_shared<ConfigurationObserver>(*this);
+            server.the_display_configuration_observer_registrar()->register_interest(configuration_observer);
+
+            std::string known;
+            {
+                std::lock_guard<decltype(mutex)> lock{mutex};
+                for (auto const& [name, id] : ids)
+                    known += (known.empty() ? "" : ", ") + name;
+            }
+
+            for (auto const& rule : rules)
+            {
+                if (!id_of(rule.output))
+                {
+                    mir::log_warning("Output rule for \"%s\": the display layout has no output %s (it has %s)",
+                        rule.value.c_str(), rule.output.c_str(), known.c_str());
+                }
+            }
+        });
+}
+
+auto FrameOutputNames::id_of(std::string const& name) const -> std::optional<int>
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    if (auto const i = ids.find(name); i != ids.end())
+        return i->second;
+
+    return std::nullopt;
+}
+
+void FrameOutputNames::update(mir::graphics::DisplayConfiguration const& configuration)
+{
+    std::map<std::string, int> names;
+
+    // Counted per card and type, over every connector whether or not anything is plugged in
+    std::map<std::pair<int, int>, int> count;
+    configuration.for_each_output([&](mir::graphics::DisplayConfigurationOutput const& output)
+        {
+            auto const card = output.card_id.as_value();
+            auto const number = ++count[{card, static_cast<int>(output.type)}];
+
+            // The layout names outputs per card, and a rule doesn't say which: the first card wins
+            names.emplace(type_name(output.type) + ("-" + std::to_string(number)), output.id.as_value());
+        });
+
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    ids = std::move(names);
+}
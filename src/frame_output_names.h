@@ -0,0 +1,62 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef FRAME_OUTPUT_NAMES_H
+#define FRAME_OUTPUT_NAMES_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace mir
+{
+class Server;
+namespace graphics { class DisplayConfiguration; }
+}
+
+struct FrameOutputRule;
+
+/// Names the outputs as the display layout (e.g. frame.display) does: by connector type, numbered from 1 for each
+/// type on a card in the card's order, counting connectors with nothing plugged in (e.g. "HDMI-A-2", "eDP-1")
+class FrameOutputNames
+{
+public:
+    /// The rules are checked against the output names once the display is configured
+    explicit FrameOutputNames(std::vector<FrameOutputRule> const& rules);
+    ~FrameOutputNames();
+
+    void operator()(mir::Server& server);
+
+    /// The id of the named output (as in miral::Output::id()), if there is one. Safe to call from any thread.
+    auto id_of(std::string const& name) const -> std::optional<int>;
+
+private:
+    struct ConfigurationObserver;
+
+    void update(mir::graphics::DisplayConfiguration const& configuration);
+
+    std::vector<FrameOutputRule> const& rules;
+    std::shared_ptr<ConfigurationObserver> configuration_observer;
+
+    std::mutex mutable mutex;
+    std::map<std::string, int> ids;
+};
+
+#endif // FRAME_OUTPUT_NAMES_H
@@ -0,0 +1,199 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frame_output_power_saver.h"
+#include "frame_idle_monitor.h"
+
+#include <mir/display_configuration_controller.h>
+#include <mir/graphics/display.h>
+#include <mir/graphics/display_configuration.h>
+#include <mir/log.h>
+#include <mir/server.h>
+
+#include <boost/throw_exception.hpp>
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <system_error>
+
+using namespace std::chrono;
+namespace geom = mir::geometry;
+
+FrameOutputPowerSaver::FrameOutputPowerSaver(miral::MirRunner& runner, FrameIdleMonitor& idle_monitor) :
+    runner{runner},
+    idle_monitor{idle_monitor},
+    timer{timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)}
+{
+    if (timer < 0)
+    {
+        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to create timer"}));
+    }
+
+    runner.add_start_callback([this] { start(); });
+
+    // Catch up with any windows placed while the outputs were idle
+    idle_monitor.on_wake([this] { if (grace != seconds::zero()) wake_main_loop(); });
+    runner.add_stop_callback([this]
+        {
+            timer_handle.reset();
+            display_controller.reset();
+            display.reset();
+        });
+}
+
+FrameOutputPowerSaver::~FrameOutputPowerSaver() = default;
+
+void FrameOutputPowerSaver::timeout(int seconds)
+{
+    grace = std::chrono::seconds{std::max(seconds, 0)};
+}
+
+void FrameOutputPowerSaver::operator()(mir::Server& server)
+{
+    server.add_init_callback([this, &server]
+        {
+            if (grace == seconds::zero())
+                return;
+
+            display_controller = server.the_display_configuration_controller();
+            display = server.the_display();
+        });
+}
+
+void FrameOutputPowerSaver::start()
+{
+    if (grace == seconds::zero())
+        return;
+
+    timer_handle = runner.register_fd_handler(timer, [this](int fd)
+        {
+            uint64_t expirations;
+            if (read(fd, &expirations, sizeof expirations) == sizeof expirations)
+                on_timer();
+        });
+
+    wake_main_loop();
+}
+
+void FrameOutputPowerSaver::windows(std::vector<geom::Rectangle> areas)
+{
+    if (grace == seconds::zero())
+        return;
+
+    {
+        std::lock_guard<decltype(mutex)> lock{mutex};
+        if (areas == window_areas)
+            return;
+
+        window_areas = std::move(areas);
+    }
+
+    wake_main_loop();
+}
+
+void FrameOutputPowerSaver::placing(geom::Rectangle const& area)
+{
+    if (grace == seconds::zero())
+        return;
+
+    {
+        std::lock_guard<decltype(mutex)> lock{mutex};
+        placing_areas.push_back(area);
+    }
+
+    wake_main_loop();
+}
+
+void FrameOutputPowerSaver::wake_main_loop()
+{
+    // A zero it_value disarms the timer, so fire a nanosecond from now
+    itimerspec const spec{{0, 0}, {0, 1}};
+    timerfd_settime(timer, 0, &spec, nullptr);
+}
+
+auto FrameOutputPowerSaver::in_use(geom::Rectangle const& extents) const -> bool
+{
+    auto const overlaps = [&](geom::Rectangle const& area) { return extents.overlaps(area); };
+
+    return std::any_of(begin(window_areas), end(window_areas), overlaps) ||
+        std::any_of(begin(placing_areas), end(placing_areas), overlaps);
+}
+
+void FrameOutputPowerSaver::on_timer()
+{
+    // Powering an output up now would leave it lit with the compositor stopped. We're woken when it restarts.
+    if (idle_monitor.idle())
+        return;
+
+    auto const now = Clock::now();
+    auto next_check = Clock::time_point::max();
+    bool changed = false;
+
+    std::shared_ptr<mir::graphics::DisplayConfiguration> const configuration = display->configuration();
+    {
+        std::lock_guard<decltype(mutex)> lock{mutex};
+
+        configuration->for_each_output([&](mir::graphics::UserDisplayConfigurationOutput& output)
+            {
+                if (!output.used || !output.connected)
+                    return;
+
+                auto const id = output.id.as_value();
+                auto const [used, _] = last_used.try_emplace(id, now);
+
+                if (in_use(output.extents()))
+                {
+                    used->second = now;
+
+                    if (powered_down[id])
+                    {
+                        mir::log_info("Powering up output %d for a new window", id);
+                        output.power_mode = mir_power_mode_on;
+                        powered_down[id] = false;
+                        changed = true;
+                    }
+                }
+                else if (!powered_down[id] && output.power_mode == mir_power_mode_on)
+                {
+                    if (now - used->second >= grace)
+                    {
+                        mir::log_info("Powering down output %d: no windows for %ds", id, int(grace.count()));
+                        output.power_mode = mir_power_mode_off;
+                        powered_down[id] = true;
+                        changed = true;
+                    }
+                    else
+                    {
+                        next_check = std::min(next_check, used->second + grace);
+                    }
+                }
+            });
+
+        // Placements have been acted on, the windows are in window_areas from now on
+        placing_areas.clear();
+    }
+
+    if (changed)
+        display_controller->set_base_configuration(configuration);
+
+    if (next_check != Clock::time_point::max())
+    {
+        auto const delay_ns = std::max(duration_cast<nanoseconds>(next_check - now).count(), nanoseconds::rep{1});
+        itimerspec const spec{{0, 0}, {time_t(delay_ns / 1000000000), long(delay_ns % 1000000000)}};
+        timerfd_settime(timer, 0, &spec, nullptr);
+    }
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_OUTPUT_POWER_SAVER_H
+#define FRAME_OUTPUT_POWER_SAVER_H
+
+#include <miral/runner.h>
+#include <mir/fd.h>
+#include <mir/geometry/rectangle.h>
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace mir
+{
+class DisplayConfigurationController;
+class Server;
+namespace graphics { class Display; }
+}
+
+class FrameIdleMonitor;
+
+/// Powers down outputs that have shown no client window (only the wallpaper) for a grace period, and powers them
+/// up again as soon as a window is placed on them (but not while the idle monitor has the outputs powered down)
+class FrameOutputPowerSaver
+{
+public:
+    FrameOutputPowerSaver(miral::MirRunner& runner, FrameIdleMonitor& idle_monitor);
+    ~FrameOutputPowerSaver();
+
+    // Used in initialization. A timeout of 0 disables the power saving.
+    void timeout(int seconds);
+
+    void operator()(mir::Server& server);
+
+    /// The areas of the visible client windows. Called by the window manager when they may have changed.
+    void windows(std::vector<mir::geometry::Rectangle> areas);
+
+    /// A window is about to be placed at area: power up the outputs it covers without waiting for it
+    void placing(mir::geometry::Rectangle const& area);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void start();
+    void on_timer();
+    void wake_main_loop();
+    auto in_use(mir::geometry::Rectangle const& extents) const -> bool;
+
+    miral::MirRunner& runner;
+    FrameIdleMonitor const& idle_monitor;
+    std::chrono::seconds grace{0};
+
+    std::shared_ptr<mir::DisplayConfigurationController> display_controller;
+    std::shared_ptr<mir::graphics::Display> display;
+
+    mir::Fd const timer;
+    std::unique_ptr<miral::FdHandle> timer_handle;
+
+    // Shared between the window manager and the main loop
+    std::mutex mutable mutex;
+    std::vector<mir::geometry::Rectangle> window_areas;
+    std::vector<mir::geometry::Rectangle> placing_areas;
+
+    // Main loop only: when each output (by id) last had a window, and those we powered down
+    std::map<int, Clock::time_point> last_used;
+    std::map<int, bool> powered_down;
+};
+
+#endif // FRAME_OUTPUT_POWER_SAVER_H
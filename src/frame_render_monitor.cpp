@@ -0,0 +1,355 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frame_render_monitor.h"
+
+#include <mir/graphics/buffer.h>
+#include <mir/graphics/renderable.h>
+#include <mir/log.h>
+
+#include <algorithm>
+
+using namespace std::chrono;
+namespace geom = mir::geometry;
+
+void RenderMonitor::Histogram::add(Clock::duration duration)
+{
+    auto const ms = duration_cast<milliseconds>(duration).count();
+    auto const bucket = std::upper_bound(begin(bounds_ms), end(bounds_ms), ms - 1) - begin(bounds_ms);
+    ++counts[bucket];
+}
+
+auto RenderMonitor::Histogram::operator+=(Histogram const& other) -> Histogram&
+{
+    for (auto i = 0u; i != counts.size(); ++i)
+    {
+        counts[i] += other.counts[i];
+    }
+    return *this;
+}
+
+auto RenderMonitor::Histogram::total() const -> uint32_t
+{
+    uint32_t total = 0;
+    for (auto count : counts)
+    {
+        total += count;
+    }
+    return total;
+}
+
+RenderMonitor::RenderMonitor() = default;
+
+void RenderMonitor::set_refresh_rate(geom::Rectangle const& area, double refresh_hz)
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+
+    auto const existing = std::find_if(begin(refresh_rates), end(refresh_rates),
+        [&](auto const& entry) { return entry.first == area; });
+
+    if (existing != end(refresh_rates))
+    {
+        existing->second = refresh_hz;
+    }
+    else
+    {
+        refresh_rates.emplace_back(area, refresh_hz);
+    }
+}
+
+void RenderMonitor::remove_refresh_rate(geom::Rectangle const& area)
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+
+    auto const same_area = [&](auto const& entry) { return entry.first == area; };
+    refresh_rates.erase(std::remove_if(begin(refresh_rates), end(refresh_rates), same_area), end(refresh_rates));
+}
+
+void RenderMonitor::set_drop_threshold(seconds sustained_for)
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    sustained_drop = sustained_for;
+}
+
+auto RenderMonitor::refresh_rate_of(geom::Rectangle const& area) const -> double
+{
+    // Called with mutex held
+    auto const existing = std::find_if(begin(refresh_rates), end(refresh_rates),
+        [&](auto const& entry) { return entry.first == area; });
+
+    return existing != end(refresh_rates) ? existing->second : 0.0;
+}
+
+auto RenderMonitor::display_for(SubCompositorId id) -> Display&
+{
+    // Each compositor thread reports for a single display, so remembering it keeps the global lock (and the map
+    // lookup) off the frame path. The displays are only dropped when compositing stops, which starts a new generation.
+    struct Cached
+    {
+        RenderMonitor const* monitor;
+        SubCompositorId id;
+        uint64_t generation;
+        Display* display;
+    };
+    thread_local Cached cached{};
+
+    if (cached.monitor == this && cached.id == id && cached.generation == generation.load())
+    {
+        return *cached.display;
+    }
+
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    auto& display = displays[id];
+
+    if (!display)
+    {
+        display = std::make_unique<Display>();
+    }
+
+    cached = {this, id, generation.load(), display.get()};
+    return *display;
+}
+
+void RenderMonitor::added_display(int width, int height, int x, int y, SubCompositorId id)
+{
+    auto& display = display_for(id);
+
+    std::lock_guard<decltype(display.mutex)> lock{display.mutex};
+    display.area = geom::Rectangle{{x, y}, {width, height}};
+    display.window = {};
+    display.current = 0;
+    display.current_start = Clock::now();
+    display.last_finished = {};
+    display.buffers_of_renderables.clear();
+    display.next_buffers_of_renderables.clear();
+    display.slow_seconds = 0;
+}
+
+void RenderMonitor::on_compositor_thread(std::function<void()> setup)
+{
+    compositor_thread_setup = std::move(setup);
+}
+
+void RenderMonitor::began_frame(SubCompositorId id)
+{
+    thread_local bool setup_done = false;
+    if (!setup_done)
+    {
+        setup_done = true;
+        if (compositor_thread_setup)
+            compositor_thread_setup();
+    }
+
+    display_for(id).frame_started = Clock::now();
+}
+
+void RenderMonitor::renderables_in_frame(SubCompositorId id, mir::graphics::RenderableList const& renderables)
+{
+    auto& display = display_for(id);
+
+    // A renderable showing a different buffer from last frame means its client committed new content. The
+    // buffers are kept sorted by renderable, and the two lists are swapped each frame so their storage is reused.
+    auto& previous = display.buffers_of_renderables;
+    auto& current = display.next_buffers_of_renderables;
+    uint32_t commits = 0;
+
+    current.clear();
+    for (auto const& renderable : renderables)
+    {
+        current.emplace_back(renderable->id(), renderable->buffer().get());
+    }
+    std::sort(begin(current), end(current));
+
+    for (auto const& [id, buffer] : current)
+    {
+        auto const found = std::lower_bound(begin(previous), end(previous), std::make_pair(id, buffer));
+
+        if (found == end(previous) || *found != std::make_pair(id, buffer))
+        {
+            ++commits;
+        }
+    }
+
+    std::swap(previous, current);
+
+    if (commits)
+    {
+        last_commit_ticks = Clock::now().time_since_epoch().count();
+    }
+
+    std::lock_guard<decltype(display.mutex)> lock{display.mutex};
+    display.window[display.current].commits += commits;
+}
+
+void RenderMonitor::rendered_frame(SubCompositorId /*id*/)
+{
+}
+
+void RenderMonitor::finished_frame(SubCompositorId id)
+{
+    auto& display = display_for(id);
+    auto const now = Clock::now();
+
+    rotate(display, now);
+
+    std::lock_guard<decltype(display.mutex)> lock{display.mutex};
+    auto& second = display.window[display.current];
+
+    ++second.frames;
+    second.frame_time.add(now - display.frame_started);
+
+    if (display.last_finished != Clock::time_point{})
+    {
+        second.frame_interval.add(now - display.last_finished);
+    }
+
+    display.last_finished = now;
+}
+
+void RenderMonitor::rotate(Display& display, Clock::time_point now)
+{
+    Second completed;
+    geom::Rectangle area;
+    {
+        std::lock_guard<decltype(display.mutex)> lock{display.mutex};
+
+        if (now - display.current_start < seconds{1})
+            return;
+
+        completed = display.window[display.current];
+        area = display.area;
+
+        // Skip any whole seconds without frames, leaving them empty
+        auto const elapsed = std::min<int>(duration_cast<seconds>(now - display.current_start).count(), window_seconds);
+        for (auto i = 0; i != elapsed; ++i)
+        {
+            display.current = (display.current + 1) % window_seconds;
+            display.window[display.current] = {};
+        }
+        display.current_start = now;
+
+        if (elapsed > 1)
+        {
+            // There was a gap without frames, so the completed second doesn't represent sustained animation
+            completed = {};
+        }
+    }
+
+    double refresh_hz;
+    seconds threshold;
+    {
+        std::lock_guard<decltype(mutex)> lock{mutex};
+        refresh_hz = refresh_rate_of(area);
+        threshold = sustained_drop;
+    }
+
+    // The compositor only renders when something changes, so a low frame rate is only interesting when content is
+    // animating. We treat a second in which frames rarely stopped for longer than two refresh periods as animating.
+    auto const long_gaps = [&]
+        {
+            uint32_t count = 0;
+            auto const limit = refresh_hz > 0 ? 2000/refresh_hz : 34;
+            for (auto i = 0u; i != Histogram::bounds_ms.size(); ++i)
+            {
+                if (Histogram::bounds_ms[i] > limit)
+                    count += completed.frame_interval.counts[i + 1];
+            }
+            return count;
+        }();
+
+    bool const animating = completed.frames > 1 && long_gaps <= completed.frames/10;
+
+    if (refresh_hz > 0 && animating && completed.frames < 0.9*refresh_hz)
+    {
+        if (++display.slow_seconds == threshold.count())
+        {
+            mir::log_warning(
+                "Output %dx%d+%d+%d rendering at %u fps (refresh %.1f Hz, %u client commits/s) for %ds",
+                area.size.width.as_int(), area.size.height.as_int(),
+                area.top_left.x.as_int(), area.top_left.y.as_int(),
+                completed.frames, refresh_hz, completed.commits, int(threshold.count()));
+        }
+    }
+    else
+    {
+        if (display.slow_seconds >= threshold.count())
+        {
+            mir::log_info(
+                "Output %dx%d+%d+%d frame rate recovered after %ds",
+                area.size.width.as_int(), area.size.height.as_int(),
+                area.top_left.x.as_int(), area.top_left.y.as_int(),
+                display.slow_seconds);
+        }
+        display.slow_seconds = 0;
+    }
+}
+
+auto RenderMonitor::statistics() const -> std::vector<OutputStatistics>
+{
+    std::vector<OutputStatistics> result;
+
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    for (auto const& [id, display] : displays)
+    {
+        OutputStatistics stats{};
+        uint32_t frames = 0;
+        uint32_t commits = 0;
+        {
+            std::lock_guard<decltype(display->mutex)> display_lock{display->mutex};
+            stats.area = display->area;
+
+            // The window is only rotated when frames finish, so leave out seconds that have aged out since
+            auto const idle = duration_cast<seconds>(Clock::now() - display->current_start).count();
+            for (auto age = 0; age + idle < window_seconds; ++age)
+            {
+                auto const& second = display->window[(display->current + window_seconds - age) % window_seconds];
+                frames += second.frames;
+                commits += second.commits;
+                stats.frame_interval += second.frame_interval;
+                stats.frame_time += second.frame_time;
+            }
+        }
+
+        stats.refresh_hz = refresh_rate_of(stats.area);
+        stats.frames_per_second = double(frames)/window_seconds;
+        stats.commits_per_second = double(commits)/window_seconds;
+        result.push_back(stats);
+    }
+
+    return result;
+}
+
+auto RenderMonitor::last_commit() const -> Clock::time_point
+{
+    return Clock::time_point{Clock::duration{last_commit_ticks.load()}};
+}
+
+void RenderMonitor::started()
+{
+}
+
+void RenderMonitor::stopped()
+{
+    // The compositing threads have finished, and each display gets a new id (and added_display()) when restarted,
+    // so drop the displays rather than keep reporting outputs that may no longer exist
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    displays.clear();
+    ++generation;
+}
+
+void RenderMonitor::scheduled()
+{
+}
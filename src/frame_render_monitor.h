@@ -0,0 +1,134 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_RENDER_MONITOR_H
+#define FRAME_RENDER_MONITOR_H
+
+#include <mir/compositor/compositor_report.h>
+#include <mir/geometry/rectangle.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/// Tracks per-output compositor frame rate, client commit rate and frame time from the compositor's report
+/// hooks. Logs sustained periods of animation below the output's refresh rate.
+///
+/// The report hooks don't say when a frame reaches the screen, so presentation latency isn't measured.
+class RenderMonitor : public mir::compositor::CompositorReport
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Histogram
+    {
+        // Upper bounds (in milliseconds) of each bucket but the last, which collects everything larger
+        static std::array<int, 10> constexpr bounds_ms{1, 2, 4, 8, 12, 17, 25, 34, 50, 100};
+
+        std::array<uint32_t, bounds_ms.size() + 1> counts{};
+
+        void add(Clock::duration duration);
+        auto operator+=(Histogram const& other) -> Histogram&;
+        auto total() const -> uint32_t;
+    };
+
+    struct OutputStatistics
+    {
+        mir::geometry::Rectangle area;
+        double refresh_hz;
+        double frames_per_second;           // Average over the rolling window
+        double commits_per_second;          // Client buffers composited, averaged over the rolling window
+        Histogram frame_interval;           // Time between successive frames
+        Histogram frame_time;               // Time from starting composition to posting the frame
+    };
+
+    RenderMonitor();
+
+    /// Used by the window manager to tell us the refresh rate of an output
+    void set_refresh_rate(mir::geometry::Rectangle const& area, double refresh_hz);
+
+    /// Used by the window manager when an output has moved, resized or gone
+    void remove_refresh_rate(mir::geometry::Rectangle const& area);
+
+    void set_drop_threshold(std::chrono::seconds sustained_for);
+
+    /// Used in initialization: called on each compositor thread before its first frame
+    void on_compositor_thread(std::function<void()> setup);
+
+    /// A snapshot of the rolling window for each output. Safe to call from any thread.
+    auto statistics() const -> std::vector<OutputStatistics>;
+
+    /// When a client buffer was last composited (or the epoch if never). Safe to call from any thread.
+    auto last_commit() const -> Clock::time_point;
+
+    // CompositorReport
+    void added_display(int width, int height, int x, int y, SubCompositorId id) override;
+    void began_frame(SubCompositorId id) override;
+    void renderables_in_frame(SubCompositorId id, mir::graphics::RenderableList const& renderables) override;
+    void rendered_frame(SubCompositorId id) override;
+    void finished_frame(SubCompositorId id) override;
+    void started() override;
+    void stopped() override;
+    void scheduled() override;
+
+private:
+    static auto constexpr window_seconds = 10;
+
+    struct Second
+    {
+        uint32_t frames = 0;
+        uint32_t commits = 0;
+        Histogram frame_interval;
+        Histogram frame_time;
+    };
+
+    struct Display
+    {
+        mir::geometry::Rectangle area;
+
+        // Only touched by the compositor thread for this display
+        Clock::time_point frame_started;
+        Clock::time_point last_finished;
+        std::vector<std::pair<void const*, void const*>> buffers_of_renderables;  // (renderable, buffer)
+        std::vector<std::pair<void const*, void const*>> next_buffers_of_renderables;
+        int slow_seconds = 0;
+
+        // Shared with readers and guarded by the mutex
+        std::mutex mutable mutex;
+        Clock::time_point current_start;
+        std::array<Second, window_seconds> window;
+        int current = 0;
+    };
+
+    void rotate(Display& display, Clock::time_point now);
+    auto display_for(SubCompositorId id) -> Display&;
+    auto refresh_rate_of(mir::geometry::Rectangle const& area) const -> double;
+
+    std::mutex mutable mutex;
+    std::map<SubCompositorId, std::unique_ptr<Display>> displays;
+    std::atomic<uint64_t> generation{0};    // Incremented when the displays are dropped (see display_for())
+    std::vector<std::pair<mir::geometry::Rectangle, double>> refresh_rates;
+    std::chrono::seconds sustained_drop{5};
+    std::atomic<Clock::rep> last_commit_ticks{0};
+    std::function<void()> compositor_thread_setup;
+};
+
+#endif // FRAME_RENDER_MONITOR_H
@@ -0,0 +1,246 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frame_screencopy.h"
+
+#include "wlr-screencopy-unstable-v1.h"
+
+#include <mir/log.h>
+
+#include <algorithm>
+#include <cstring>
+
+class Screencopy::Buffer
+{
+public:
+    ~Buffer()
+    {
+        if (buffer)
+            wl_buffer_destroy(buffer);
+    }
+
+    auto matches(uint32_t format, int32_t width, int32_t height, int32_t stride) const -> bool
+    {
+        return buffer &&
+            this->format == format && this->width == width && this->height == height && this->stride == stride;
+    }
+
+    void allocate(egmde::FullscreenClient const& client, uint32_t format, int32_t width, int32_t height, int32_t stride)
+    {
+        if (buffer)
+            wl_buffer_destroy(buffer);
+
+        size_t const size = stride * height;
+        void* data;
+        {
+            auto const pool = client.make_shm_pool(size, &data);
+            buffer = wl_shm_pool_create_buffer(pool.get(), 0, width, height, stride, format);
+        }
+
+        pixels = std::shared_ptr<void const>{data,
+            [size](void const* data) { egmde::FullscreenClient::unmap_shm(const_cast<void*>(data), size); }};
+        this->format = format;
+        this->width = width;
+        this->height = height;
+        this->stride = stride;
+    }
+
+    wl_buffer* buffer = nullptr;
+    std::shared_ptr<void const> pixels;
+    uint32_t format = 0;
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t stride = 0;
+};
+
+struct Screencopy::Request
+{
+    Screencopy* const self;
+    zwlr_screencopy_frame_v1* const frame;
+    std::shared_ptr<Buffer> const buffer;
+    bool const wait_for_damage;
+    std::function<void(Image const&)> const on_ready;
+    std::function<void()> const on_failed;
+
+    uint32_t format = 0;
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t stride = 0;
+    bool y_invert = false;
+    bool copied = false;
+
+    void copy()
+    {
+        if (copied)
+            return;
+
+        copied = true;
+
+        if (!buffer->matches(format, width, height, stride))
+        {
+            buffer->allocate(self->client, format, width, height, stride);
+        }
+
+        if (wait_for_damage)
+        {
+            zwlr_screencopy_frame_v1_copy_with_damage(frame, buffer->buffer);
+        }
+        else
+        {
+            zwlr_screencopy_frame_v1_copy(frame, buffer->buffer);
+        }
+    }
+
+    static void handle_buffer(
+        void* data, zwlr_screencopy_frame_v1*, uint32_t format, uint32_t width, uint32_t height, uint32_t stride)
+    {
+        auto const request = static_cast<Request*>(data);
+
+        // We can only read formats we understand, and wl_shm guarantees one of these
+        if (format != WL_SHM_FORMAT_ARGB8888 && format != WL_SHM_FORMAT_XRGB8888)
+            return;
+
+        request->format = format;
+        request->width = width;
+        request->height = height;
+        request->stride = stride;
+
+        // Before version 3 there is no buffer_done event, so the only buffer offered is the one to use
+        if (request->self->manager_version < 3)
+            request->copy();
+    }
+
+    static void handle_flags(void* data, zwlr_screencopy_frame_v1*, uint32_t flags)
+    {
+        static_cast<Request*>(data)->y_invert = flags & ZWLR_SCREENCOPY_FRAME_V1_FLAGS_Y_INVERT;
+    }
+
+    static void handle_ready(void* data, zwlr_screencopy_frame_v1* frame, uint32_t, uint32_t, uint32_t)
+    {
+        auto const request = static_cast<Request*>(data);
+        auto const& buffer = *request->buffer;
+
+        request->on_ready(Image{buffer.pixels, buffer.width, buffer.height, buffer.stride, buffer.format, request->y_invert});
+        request->self->requests.erase(frame);
+    }
+
+    static void handle_failed(void* data, zwlr_screencopy_frame_v1* frame)
+    {
+        mir::log_warning("Screencopy of output failed");
+        auto const request = static_cast<Request*>(data);
+        request->on_failed();
+        request->self->requests.erase(frame);
+    }
+
+    static void handle_damage(void*, zwlr_screencopy_frame_v1*, uint32_t, uint32_t, uint32_t, uint32_t)
+    {
+    }
+
+    static void handle_linux_dmabuf(void*, zwlr_screencopy_frame_v1*, uint32_t, uint32_t, uint32_t)
+    {
+    }
+
+    static void handle_buffer_done(void* data, zwlr_screencopy_frame_v1* frame)
+    {
+        auto const request = static_cast<Request*>(data);
+
+        if (!request->width)
+        {
+            mir::log_warning("Screencopy offered no usable shm format");
+            request->on_failed();
+            request->self->requests.erase(frame);
+            return;
+        }
+
+        request->copy();
+    }
+
+    static zwlr_screencopy_frame_v1_listener const listener;
+
+    ~Request()
+    {
+        zwlr_screencopy_frame_v1_destroy(frame);
+    }
+};
+
+zwlr_screencopy_frame_v1_listener const Screencopy::Request::listener = {
+    &handle_buffer,
+    &handle_flags,
+    &handle_ready,
+    &handle_failed,
+    &handle_damage,
+    &handle_linux_dmabuf,
+    &handle_buffer_done,
+};
+
+Screencopy::Screencopy(wl_display* display, egmde::FullscreenClient const& client) :
+    client{client},
+    registry{wl_display_get_registry(display), &wl_registry_destroy}
+{
+    static wl_registry_listener const registry_listener = {
+        [](void* self, auto... args) { static_cast<Screencopy*>(self)->new_global(args...); },
+        [](void*, auto...) {},
+    };
+
+    wl_registry_add_listener(registry.get(), &registry_listener, this);
+}
+
+Screencopy::~Screencopy()
+{
+    requests.clear();
+
+    if (manager)
+        zwlr_screencopy_manager_v1_destroy(manager);
+}
+
+void Screencopy::new_global(wl_registry* registry, uint32_t id, char const* interface, uint32_t version)
+{
+    if (strcmp(interface, zwlr_screencopy_manager_v1_interface.name) == 0)
+    {
+        manager_version = std::min(version, 3u);
+        manager = static_cast<decltype(manager)>(
+            wl_registry_bind(registry, id, &zwlr_screencopy_manager_v1_interface, manager_version));
+    }
+}
+
+auto Screencopy::make_buffer() -> std::shared_ptr<Buffer>
+{
+    return std::make_shared<Buffer>();
+}
+
+void Screencopy::capture(
+    wl_output* output,
+    std::shared_ptr<Buffer> const& buffer,
+    bool wait_for_damage,
+    std::function<void(Image const&)> on_ready,
+    std::function<void()> on_failed)
+{
+    if (!manager)
+    {
+        mir::log_warning("Screencopy is not available to internal clients");
+        on_failed();
+        return;
+    }
+
+    // copy_with_damage() arrived in version 2, before that we just copy
+    wait_for_damage = wait_for_damage && manager_version >= 2;
+
+    auto const frame = zwlr_screencopy_manager_v1_capture_output(manager, 0, output);
+    auto& request = requests[frame];
+    request.reset(new Request{this, frame, buffer, wait_for_damage, std::move(on_ready), std::move(on_failed)});
+
+    zwlr_screencopy_frame_v1_add_listener(frame, &Request::listener, request.get());
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_SCREENCOPY_H
+#define FRAME_SCREENCOPY_H
+
+#include "egfullscreenclient.h"
+
+#include <functional>
+#include <map>
+#include <memory>
+
+struct zwlr_screencopy_manager_v1;
+struct zwlr_screencopy_frame_v1;
+
+/// Copies output content into shm buffers owned by an internal client using wlr-screencopy.
+/// All functions must be called on the thread dispatching the client's Wayland events.
+class Screencopy
+{
+public:
+    /// The pixels of a completed capture. The pixels remain mapped while any copy of the Image exists.
+    struct Image
+    {
+        std::shared_ptr<void const> pixels;
+        int32_t width;
+        int32_t height;
+        int32_t stride;
+        uint32_t format;
+        bool y_invert;
+    };
+
+    /// A destination for captures. Reusing a Buffer across captures avoids allocating a new shm pool each
+    /// time, but the previous Image must no longer be in use when the next capture completes.
+    class Buffer;
+
+    Screencopy(wl_display* display, egmde::FullscreenClient const& client);
+    ~Screencopy();
+
+    Screencopy(Screencopy const&) = delete;
+    Screencopy& operator=(Screencopy const&) = delete;
+
+    /// Whether the compositor offers screencopy to this client
+    auto available() const -> bool { return manager != nullptr; }
+
+    /// Capture the next frame of output into buffer. If wait_for_damage is set the copy only completes after
+    /// the output content changes. Exactly one of on_ready or on_failed is eventually called.
+    void capture(
+        wl_output* output,
+        std::shared_ptr<Buffer> const& buffer,
+        bool wait_for_damage,
+        std::function<void(Image const&)> on_ready,
+        std::function<void()> on_failed = []{});
+
+    static auto make_buffer() -> std::shared_ptr<Buffer>;
+
+private:
+    struct Request;
+
+    void new_global(wl_registry* registry, uint32_t id, char const* interface, uint32_t version);
+
+    egmde::FullscreenClient const& client;
+    std::unique_ptr<wl_registry, decltype(&wl_registry_destroy)> const registry;
+    zwlr_screencopy_manager_v1* manager = nullptr;
+    uint32_t manager_version = 0;
+
+    std::map<zwlr_screencopy_frame_v1*, std::unique_ptr<Request>> requests;
+};
+
+#endif // FRAME_SCREENCOPY_H
@@ -0,0 +1,167 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frame_screenshot.h"
+#include "frame_screencopy.h"
+#include "egfullscreenclient.h"
+
+#include <mir/log.h>
+
+#include <chrono>
+#include <ctime>
+#include <exception>
+#include <future>
+#include <vector>
+
+namespace
+{
+auto timestamp() -> std::string
+{
+    auto const now = time(nullptr);
+    tm local;
+    localtime_r(&now, &local);
+
+    char buffer[32];
+    strftime(buffer, sizeof buffer, "%Y-%m-%dT%H:%M:%S", &local);
+    return buffer;
+}
+
+auto default_directory() -> std::string
+{
+    for (auto const var : {"SNAP_USER_COMMON", "XDG_RUNTIME_DIR"})
+    {
+        if (auto const dir = getenv(var))
+            return dir;
+    }
+
+    return "/tmp";
+}
+}
+
+struct FrameScreenshot::Self : egmde::FullscreenClient
+{
+    Self(wl_display* display, FullscreenClient& host, std::string directory, ImageFormat format);
+    ~Self();
+
+    // We don't draw anything, we only track the outputs
+    void draw_screen(SurfaceInfo&) const override {}
+
+    void capture();
+
+    std::string const directory;
+    ImageFormat const format;
+
+    Screencopy screencopy;
+
+    // Encoding runs on worker threads so the Wayland connection stays responsive.
+    // Only accessed on the client thread.
+    std::vector<std::future<void>> encoders;
+};
+
+FrameScreenshot::Self::Self(wl_display* display, FullscreenClient& host, std::string directory, ImageFormat format) :
+    FullscreenClient(display, &host),
+    directory{std::move(directory)},
+    format{format},
+    screencopy{display, *this}
+{
+    wl_display_roundtrip(display);
+}
+
+FrameScreenshot::Self::~Self()
+{
+    // Wait for any encoding in progress
+    encoders.clear();
+}
+
+void FrameScreenshot::Self::capture()
+{
+    std::erase_if(encoders, [](auto const& encoder)
+        {
+            return encoder.wait_for(std::chrono::seconds::zero()) == std::future_status::ready;
+        });
+
+    if (!encoders.empty())
+    {
+        mir::log_info("Screenshot already in progress, ignoring request");
+        return;
+    }
+
+    auto const stem = directory + "/frame_" + timestamp();
+    int index = 0;
+
+    for_each_output([&](Output const& output)
+        {
+            auto path = stem + "_" + std::to_string(index++) + "." + file_extension_of(format);
+
+            // Each capture gets its own buffer as the pixels are handed over to the encoder
+            screencopy.capture(output.output, Screencopy::make_buffer(), false,
+                [this, path=std::move(path)](Screencopy::Image const& image)
+                {
+                    encoders.push_back(std::async(std::launch::async, [format=format, path, image]
+                        {
+                            auto const start = std::chrono::steady_clock::now();
+                            try
+                            {
+                                write_image(path, format, {image.pixels.get(), image.width, image.height, image.stride, image.y_invert});
+                            }
+                            catch (std::exception const& error)
+                            {
+                                mir::log_warning("Failed to save screenshot: %s", error.what());
+                                return;
+                            }
+                            auto const elapsed = std::chrono::steady_clock::now() - start;
+
+                            mir::log_info("Screenshot saved to %s (%d ms)", path.c_str(),
+                                int(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()));
+                        }));
+                });
+        });
+}
+
+auto FrameScreenshot::connect(wl_display* display, egmde::FullscreenClient& host)
+-> std::shared_ptr<egmde::FullscreenClient>
+{
+    std::string directory;
+    ImageFormat format;
+    {
+        std::lock_guard<decltype(mutex)> lock{mutex};
+        directory = screenshot_directory.empty() ? default_directory() : screenshot_directory;
+        format = image_format;
+    }
+
+    return std::make_shared<Self>(display, host, directory, format);
+}
+
+void FrameScreenshot::capture()
+{
+    // The work queue belongs to the client, so don't let it own a reference
+    if (!with_client<Self>([](Self& client) { client.invoke([client=&client] { client->capture(); }); }))
+    {
+        mir::log_info("Screenshot requested before the internal client started");
+    }
+}
+
+void FrameScreenshot::directory(std::string const& option)
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    screenshot_directory = option;
+}
+
+void FrameScreenshot::format(std::string const& option)
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    image_format = image_format_from(option);
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_SCREENSHOT_H
+#define FRAME_SCREENSHOT_H
+
+#include "frame_client_host.h"
+#include "frame_image_writer.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+/// An internal client that captures every output to an image file on request
+class FrameScreenshot : public FrameHostedClient
+{
+public:
+    /// Capture all outputs. May be called from any thread.
+    void capture();
+
+    // Used in initialization
+    void directory(std::string const& option);
+    void format(std::string const& option);
+
+private:
+    std::mutex mutable mutex;
+
+    std::string screenshot_directory;
+    ImageFormat image_format = ImageFormat::png;
+
+    struct Self;
+
+    auto connect(wl_display* display, egmde::FullscreenClient& host)
+    -> std::shared_ptr<egmde::FullscreenClient> override;
+};
+
+#endif // FRAME_SCREENSHOT_H
@@ -0,0 +1,87 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frame_settle_timer.h"
+
+#include <boost/throw_exception.hpp>
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <system_error>
+
+FrameSettleTimer::FrameSettleTimer(miral::MirRunner& runner) :
+    runner{runner},
+    timer{timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)}
+{
+    if (timer < 0)
+    {
+        BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to create timer"}));
+    }
+
+    runner.add_start_callback([this] { start(); });
+    runner.add_stop_callback([this] { cancel(); timer_handle.reset(); });
+}
+
+FrameSettleTimer::~FrameSettleTimer() = default;
+
+void FrameSettleTimer::settle_time(int milliseconds)
+{
+    settle = std::chrono::milliseconds{std::max(milliseconds, 0)};
+}
+
+auto FrameSettleTimer::settles() const -> bool
+{
+    return settle.count() > 0;
+}
+
+void FrameSettleTimer::start()
+{
+    timer_handle = runner.register_fd_handler(timer, [this](int fd)
+        {
+            uint64_t expirations;
+            if (read(fd, &expirations, sizeof expirations) != sizeof expirations)
+                return;
+
+            std::function<void()> action;
+            {
+                std::lock_guard<decltype(mutex)> lock{mutex};
+                std::swap(action, pending);
+            }
+
+            if (action)
+                action();
+        });
+}
+
+void FrameSettleTimer::arm(std::function<void()> action)
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    pending = std::move(action);
+
+    auto const settle_ns = std::chrono::nanoseconds{settle}.count();
+    itimerspec const spec{{0, 0}, {time_t(settle_ns / 1000000000), long(settle_ns % 1000000000)}};
+    timerfd_settime(timer, 0, &spec, nullptr);
+}
+
+void FrameSettleTimer::cancel()
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    pending = nullptr;
+
+    itimerspec const disarm{};
+    timerfd_settime(timer, 0, &disarm, nullptr);
+}
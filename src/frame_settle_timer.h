@@ -0,0 +1,60 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_SETTLE_TIMER_H
+#define FRAME_SETTLE_TIMER_H
+
+#include <miral/runner.h>
+#include <mir/fd.h>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+/// Coalesces bursts of changes: the action runs on the main loop once nothing has called arm() for the settle time
+class FrameSettleTimer
+{
+public:
+    explicit FrameSettleTimer(miral::MirRunner& runner);
+    ~FrameSettleTimer();
+
+    // Used in initialization. A settle time of 0 means callers should act immediately (see settles()).
+    void settle_time(int milliseconds);
+
+    /// Whether there is a settle time, i.e. arm() defers the action
+    auto settles() const -> bool;
+
+    /// (Re)starts the settle time, replacing any pending action. Safe to call from any thread.
+    void arm(std::function<void()> action);
+
+    /// Drops any pending action. Safe to call from any thread.
+    void cancel();
+
+private:
+    void start();
+
+    miral::MirRunner& runner;
+    std::chrono::milliseconds settle{0};
+
+    mir::Fd const timer;
+    std::unique_ptr<miral::FdHandle> timer_handle;
+
+    std::mutex mutable mutex;
+    std::function<void()> pending;
+};
+
+#endif // FRAME_SETTLE_TIMER_H
@@ -0,0 +1,68 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frame_standby_apps.h"
+
+#include <algorithm>
+#include <sstream>
+
+void FrameStandbyApps::apps(std::string const& option)
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    standby.clear();
+
+    std::istringstream in{option};
+    for (std::string app; std::getline(in, app, ',');)
+    {
+        if (!app.empty())
+            standby.push_back(app);
+    }
+}
+
+void FrameStandbyApps::activate(std::string const& app)
+{
+    std::function<void(std::string const&)> handler;
+    {
+        std::lock_guard<decltype(mutex)> lock{mutex};
+        if (app == active_app)
+            return;
+
+        active_app = app;
+        handler = switch_handler;
+    }
+
+    // Not under the lock: the handler takes the window manager's lock, which may be waiting on is_standby()
+    if (handler && !app.empty())
+        handler(app);
+}
+
+auto FrameStandbyApps::is_standby(std::string const& app) const -> bool
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    return std::find(begin(standby), end(standby), app) != end(standby);
+}
+
+auto FrameStandbyApps::active() const -> std::string
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    return active_app;
+}
+
+void FrameStandbyApps::on_switch(std::function<void(std::string const&)> handler)
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    switch_handler = std::move(handler);
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_STANDBY_APPS_H
+#define FRAME_STANDBY_APPS_H
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// The applications whose fullscreen windows wait, already placed and drawn, below the active application, and
+/// which of them is active. Switching is requested by option (e.g. from the config file) and done by the window
+/// manager, which registers for it with on_switch().
+class FrameStandbyApps
+{
+public:
+    // Used in initialization: comma separated application ids (or names)
+    void apps(std::string const& option);
+
+    /// Makes app the active application. Safe to call from any thread.
+    void activate(std::string const& app);
+
+    /// Whether app is one of the standby applications
+    auto is_standby(std::string const& app) const -> bool;
+
+    /// The application last activated (empty if none)
+    auto active() const -> std::string;
+
+    /// Sets the handler called with the application whenever activate() changes it
+    void on_switch(std::function<void(std::string const&)> handler);
+
+private:
+    std::mutex mutable mutex;
+    std::vector<std::string> standby;
+    std::string active_app;
+    std::function<void(std::string const&)> switch_handler;
+};
+
+#endif // FRAME_STANDBY_APPS_H
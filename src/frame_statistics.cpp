@@ -0,0 +1,250 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frame_statistics.h"
+#include "frame_render_monitor.h"
+
+#include <mir/fd.h>
+#include <mir/log.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstring>
+#include <sstream>
+
+FrameStatistics frame_statistics;
+
+namespace
+{
+auto escape(std::string const& label) -> std::string
+{
+    std::string result;
+    for (auto c : label)
+    {
+        switch (c)
+        {
+        case '\\': result += "\\\\"; break;
+        case '"':  result += "\\\""; break;
+        case '\n': result += "\\n";  break;
+        default:   result += c;
+        }
+    }
+    return result;
+}
+
+auto name_of(mir::geometry::Rectangle const& area) -> std::string
+{
+    std::ostringstream name;
+    name << area.size.width.as_int() << 'x' << area.size.height.as_int()
+         << '+' << area.top_left.x.as_int() << '+' << area.top_left.y.as_int();
+    return name.str();
+}
+
+void metric(std::ostream& out, char const* name, char const* type, char const* help)
+{
+    out << "# HELP " << name << ' ' << help << '\n'
+        << "# TYPE " << name << ' ' << type << '\n';
+}
+}
+
+auto FrameStatistics::authorization(std::string const& protocol) -> AuthorizationCounters&
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    return authorizations[protocol];
+}
+
+void FrameStatistics::window_created(std::string const& application)
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    ++windows_per_application[application];
+}
+
+void FrameStatistics::window_deleted(std::string const& application)
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    if (--windows_per_application[application] <= 0)
+    {
+        windows_per_application.erase(application);
+    }
+}
+
+auto FrameStatistics::window_count() const -> int64_t
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    int64_t count = 0;
+    for (auto const& [_, windows] : windows_per_application)
+    {
+        count += windows;
+    }
+    return count;
+}
+
+void FrameStatistics::modify_request_dropped(std::string const& application)
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    ++modify_requests_dropped[application];
+}
+
+auto FrameStatistics::prometheus_text(RenderMonitor const* render_monitor) const -> std::string
+{
+    std::ostringstream out;
+
+    metric(out, "frame_outputs", "gauge", "Outputs with a wallpaper surface (visible) or overlapping another (hidden)");
+    out << "frame_outputs{state=\"visible\"} " << outputs_visible.load() << '\n'
+        << "frame_outputs{state=\"hidden\"} " << outputs_hidden.load() << '\n';
+
+    metric(out, "frame_fullscreen_relayouts_total", "counter", "Fullscreen windows resized for application zone changes");
+    out << "frame_fullscreen_relayouts_total " << fullscreen_relayouts.load() << '\n';
+
+    metric(out, "frame_application_zone_changes_total", "counter", "Application zones created, updated or deleted");
+    out << "frame_application_zone_changes_total " << application_zone_changes.load() << '\n';
+
+    metric(out, "frame_internal_client_shm_bytes", "gauge", "Bytes of shm currently mapped by internal clients");
+    out << "frame_internal_client_shm_bytes " << internal_client_shm_bytes.load() << '\n';
+
+    metric(out, "frame_wallpaper_redraws_total", "counter", "Wallpaper surfaces rendered");
+    out << "frame_wallpaper_redraws_total " << wallpaper_redraws.load() << '\n';
+
+    metric(out, "frame_wallpaper_cache_hits_total", "counter", "Wallpaper surfaces shown from the on-disk cache");
+    out << "frame_wallpaper_cache_hits_total " << wallpaper_cache_hits.load() << '\n';
+
+    metric(out, "frame_output_changes_ignored_total", "counter", "Output updates to internal clients that changed nothing");
+    out << "frame_output_changes_ignored_total " << output_changes_ignored.load() << '\n';
+
+    {
+        std::lock_guard<decltype(mutex)> lock{mutex};
+
+        metric(out, "frame_authorization_decisions_total", "counter", "Requests to use a restricted Wayland extension");
+        for (auto const& [protocol, counters] : authorizations)
+        {
+            out << "frame_authorization_decisions_total{protocol=\"" << escape(protocol) << "\",result=\"allowed\"} "
+                << counters.allowed.load() << '\n'
+                << "frame_authorization_decisions_total{protocol=\"" << escape(protocol) << "\",result=\"denied\"} "
+                << counters.denied.load() << '\n';
+        }
+
+        metric(out, "frame_windows", "gauge", "Windows per application");
+        for (auto const& [application, count] : windows_per_application)
+        {
+            out << "frame_windows{application=\"" << escape(application) << "\"} " << count << '\n';
+        }
+
+        metric(out, "frame_modify_requests_dropped_total", "counter", "Repeated window state changes dropped by rate limiting");
+        for (auto const& [application, count] : modify_requests_dropped)
+        {
+            out << "frame_modify_requests_dropped_total{application=\"" << escape(application) << "\"} " << count << '\n';
+        }
+    }
+
+    if (render_monitor)
+    {
+        auto const outputs = render_monitor->statistics();
+
+        metric(out, "frame_output_frames_per_second", "gauge", "Frames composited per second over the last 10 seconds");
+        for (auto const& output : outputs)
+        {
+            out << "frame_output_frames_per_second{output=\"" << name_of(output.area) << "\"} "
+                << output.frames_per_second << '\n';
+        }
+
+        metric(out, "frame_output_commits_per_second", "gauge", "Client buffers composited per second over the last 10 seconds");
+        for (auto const& output : outputs)
+        {
+            out << "frame_output_commits_per_second{output=\"" << name_of(output.area) << "\"} "
+                << output.commits_per_second << '\n';
+        }
+    }
+
+    return out.str();
+}
+
+StatisticsSocket::StatisticsSocket(miral::MirRunner& runner, RenderMonitor const& render_monitor) :
+    runner{runner},
+    render_monitor{render_monitor}
+{
+    runner.add_start_callback([this] { start(); });
+    runner.add_stop_callback([this]
+        {
+            if (listen_handle)
+            {
+                listen_handle.reset();
+                unlink(socket_path.c_str());
+            }
+        });
+}
+
+StatisticsSocket::~StatisticsSocket() = default;
+
+void StatisticsSocket::path(std::string const& option)
+{
+    if (option.empty() || option[0] == '/')
+    {
+        socket_path = option;
+    }
+    else if (auto const runtime_dir = getenv("XDG_RUNTIME_DIR"))
+    {
+        socket_path = std::string{runtime_dir} + "/" + option;
+    }
+    else
+    {
+        socket_path = option;
+    }
+}
+
+void StatisticsSocket::start()
+{
+    if (socket_path.empty())
+        return;
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+
+    if (socket_path.size() >= sizeof address.sun_path)
+    {
+        mir::log_warning("Statistics socket path too long: %s", socket_path.c_str());
+        return;
+    }
+    strncpy(address.sun_path, socket_path.c_str(), sizeof address.sun_path - 1);
+
+    mir::Fd listener{socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0)};
+
+    unlink(socket_path.c_str());
+    if (listener < 0 ||
+        bind(listener, reinterpret_cast<sockaddr const*>(&address), sizeof address) < 0 ||
+        listen(listener, 8) < 0)
+    {
+        mir::log_warning("Failed to open statistics socket %s: %s", socket_path.c_str(), strerror(errno));
+        return;
+    }
+
+    mir::log_info("Serving statistics on %s", socket_path.c_str());
+
+    listen_handle = runner.register_fd_handler(listener, [this](int fd)
+        {
+            for (int client; (client = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC)) >= 0;)
+            {
+                mir::Fd const connection{client};
+                auto const text = frame_statistics.prometheus_text(&render_monitor);
+
+                // The text is far smaller than the socket buffer, so we don't expect this to block
+                if (send(connection, text.data(), text.size(), MSG_NOSIGNAL | MSG_DONTWAIT) < 0)
+                {
+                    mir::log_debug("Failed to send statistics: %s", strerror(errno));
+                }
+            }
+        });
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_STATISTICS_H
+#define FRAME_STATISTICS_H
+
+#include <miral/runner.h>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class RenderMonitor;
+
+/// Runtime counters and gauges. The atomics may be updated from any thread without locking.
+class FrameStatistics
+{
+public:
+    using Counter = std::atomic<uint64_t>;
+    using Gauge = std::atomic<int64_t>;
+
+    struct AuthorizationCounters
+    {
+        Counter allowed{0};
+        Counter denied{0};
+    };
+
+    Gauge outputs_visible{0};
+    Gauge outputs_hidden{0};
+    Gauge internal_client_shm_bytes{0};
+    Counter fullscreen_relayouts{0};
+    Counter application_zone_changes{0};
+    Counter wallpaper_redraws{0};
+    Counter wallpaper_cache_hits{0};
+    Counter output_changes_ignored{0};
+
+    /// The counters for protocol. Intended to be called during initialization, the counters can then be updated
+    /// without locking.
+    auto authorization(std::string const& protocol) -> AuthorizationCounters&;
+
+    void window_created(std::string const& application);
+    void window_deleted(std::string const& application);
+
+    /// The windows currently open, across all applications
+    auto window_count() const -> int64_t;
+
+    /// A window management request from application was dropped by rate limiting
+    void modify_request_dropped(std::string const& application);
+
+    /// The statistics in Prometheus text exposition format
+    auto prometheus_text(RenderMonitor const* render_monitor) const -> std::string;
+
+private:
+    std::mutex mutable mutex;
+    std::map<std::string, AuthorizationCounters> authorizations;
+    std::map<std::string, int64_t> windows_per_application;
+    std::map<std::string, uint64_t> modify_requests_dropped;
+};
+
+extern FrameStatistics frame_statistics;
+
+/// Serves frame_statistics on a local Unix socket. Each connection receives the current statistics and is closed.
+class StatisticsSocket
+{
+public:
+    StatisticsSocket(miral::MirRunner& runner, RenderMonitor const& render_monitor);
+    ~StatisticsSocket();
+
+    // Used in initialization. A relative path is taken to be relative to $XDG_RUNTIME_DIR.
+    void path(std::string const& option);
+
+private:
+    void start();
+
+    miral::MirRunner& runner;
+    RenderMonitor const& render_monitor;
+    std::string socket_path;
+    std::unique_ptr<miral::FdHandle> listen_handle;
+};
+
+#endif // FRAME_STATISTICS_H
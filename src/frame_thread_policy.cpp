@@ -0,0 +1,181 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frame_thread_policy.h"
+
+#include <mir/input/composite_event_filter.h>
+#include <mir/input/event_filter.h>
+#include <mir/log.h>
+#include <mir/server.h>
+
+#include <sys/resource.h>
+#include <unistd.h>
+#include <cstring>
+#include <sstream>
+
+struct FrameThreadPolicy::InputFilter : mir::input::EventFilter
+{
+    explicit InputFilter(FrameThreadPolicy const& policy) : policy{policy} {}
+
+    bool handle(MirEvent const& /*event*/) override
+    {
+        policy.apply();
+        return false;
+    }
+
+    FrameThreadPolicy const& policy;
+};
+
+FrameThreadPolicy::FrameThreadPolicy(std::string const& threads) :
+    threads{threads}
+{
+}
+
+FrameThreadPolicy::~FrameThreadPolicy() = default;
+
+void FrameThreadPolicy::policy(std::string const& option)
+{
+    auto const colon = option.find(':');
+    auto const name = option.substr(0, colon);
+    auto const rt_priority = colon == std::string::npos ? 1 : atoi(option.c_str() + colon + 1);
+
+    if (name.empty())
+    {
+        sched_policy.reset();
+    }
+    else if (name == "other")
+    {
+        sched_policy = SCHED_OTHER;
+    }
+    else if (name == "batch")
+    {
+        sched_policy = SCHED_BATCH;
+    }
+    else if (name == "idle")
+    {
+        sched_policy = SCHED_IDLE;
+    }
+    else if (name == "fifo" || name == "rr")
+    {
+        auto const policy = name == "fifo" ? SCHED_FIFO : SCHED_RR;
+        if (rt_priority < sched_get_priority_min(policy) || rt_priority > sched_get_priority_max(policy))
+        {
+            mir::log_warning("Invalid %s thread priority '%s'", threads.c_str(), option.c_str());
+            return;
+        }
+
+        sched_policy = policy;
+        priority = rt_priority;
+    }
+    else
+    {
+        mir::log_warning(
+            "Unknown %s scheduling policy '%s' (expected other, batch, idle, fifo:<priority> or rr:<priority>)",
+            threads.c_str(), option.c_str());
+    }
+}
+
+void FrameThreadPolicy::nice(int niceness)
+{
+    if (niceness)
+    {
+        this->niceness = niceness;
+    }
+    else
+    {
+        this->niceness.reset();
+    }
+}
+
+void FrameThreadPolicy::cpus(std::string const& option)
+{
+    if (option.empty())
+    {
+        affinity.reset();
+        return;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    std::istringstream ranges{option};
+    for (std::string range; std::getline(ranges, range, ',');)
+    {
+        int first;
+        int last;
+        char dash;
+        std::istringstream in{range};
+
+        if (!(in >> first))
+        {
+            mir::log_warning("Invalid %s CPU list '%s'", threads.c_str(), option.c_str());
+            return;
+        }
+
+        if (!(in >> dash >> last))
+            last = first;
+
+        for (auto cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu)
+            CPU_SET(cpu, &set);
+    }
+
+    affinity = set;
+}
+
+auto FrameThreadPolicy::configured() const -> bool
+{
+    return sched_policy || niceness || affinity;
+}
+
+void FrameThreadPolicy::apply() const
+{
+    // Each thread adopts one policy, once
+    thread_local FrameThreadPolicy const* applied = nullptr;
+
+    if (applied == this || !configured())
+        return;
+
+    applied = this;
+
+    // These all act on the calling thread when given 0 (or its tid)
+    if (sched_policy)
+    {
+        sched_param const param{*sched_policy == SCHED_FIFO || *sched_policy == SCHED_RR ? priority : 0};
+        if (sched_setscheduler(0, *sched_policy, &param) != 0)
+            mir::log_warning("Failed to set %s scheduling policy: %s", threads.c_str(), strerror(errno));
+    }
+
+    if (niceness && setpriority(PRIO_PROCESS, gettid(), *niceness) != 0)
+        mir::log_warning("Failed to set %s niceness: %s", threads.c_str(), strerror(errno));
+
+    if (affinity && sched_setaffinity(0, sizeof *affinity, &*affinity) != 0)
+        mir::log_warning("Failed to set %s CPU affinity: %s", threads.c_str(), strerror(errno));
+
+    mir::log_debug("Applied %s scheduling to thread %d", threads.c_str(), int(gettid()));
+}
+
+void FrameThreadPolicy::operator()(mir::Server& server)
+{
+    server.add_init_callback([this, &server]
+        {
+            if (!configured())
+                return;
+
+            // The composite filter only keeps a weak reference, so we own the filter
+            input_filter = std::make_shared<InputFilter>(*this);
+            server.the_composite_event_filter()->prepend(input_filter);
+        });
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_THREAD_POLICY_H
+#define FRAME_THREAD_POLICY_H
+
+#include <sched.h>
+
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace mir
+{
+class Server;
+namespace input { class EventFilter; }
+}
+
+/// A scheduling policy, niceness and CPU affinity for a group of threads. Threads adopt it by calling apply() once
+/// they are running (threads they start inherit it).
+class FrameThreadPolicy
+{
+public:
+    explicit FrameThreadPolicy(std::string const& threads);
+    ~FrameThreadPolicy();
+
+    // Used in initialization: "other", "batch", "idle", "fifo:<priority>" or "rr:<priority>" ("" for the default)
+    void policy(std::string const& option);
+
+    // Used in initialization. Applies to "other" and "batch" threads.
+    void nice(int niceness);
+
+    // Used in initialization: CPUs such as "2-3" or "0,2" ("" for any)
+    void cpus(std::string const& option);
+
+    /// Applies the policy to the calling thread. Repeat calls from a thread are cheap no-ops.
+    void apply() const;
+
+    /// Used with MirRunner::run_with() to apply the policy to the input thread
+    void operator()(mir::Server& server);
+
+private:
+    struct InputFilter;
+
+    std::string const threads;
+
+    std::optional<int> sched_policy;
+    int priority = 0;
+    std::optional<int> niceness;
+    std::optional<cpu_set_t> affinity;
+
+    std::shared_ptr<InputFilter> input_filter;
+
+    auto configured() const -> bool;
+};
+
+#endif // FRAME_THREAD_POLICY_H
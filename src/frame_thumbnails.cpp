@@ -0,0 +1,350 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frame_thumbnails.h"
+#include "frame_screencopy.h"
+#include "egfullscreenclient.h"
+
+#include <mir/fd.h>
+#include <mir/log.h>
+
+#include <boost/throw_exception.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <system_error>
+#include <vector>
+
+namespace
+{
+auto default_file() -> std::string
+{
+    if (auto const dir = getenv("XDG_RUNTIME_DIR"))
+        return std::string{dir} + "/frame-thumbnails";
+
+    return "/tmp/frame-thumbnails";
+}
+
+auto realtime_ns() -> uint64_t
+{
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return uint64_t(now.tv_sec)*1000000000 + now.tv_nsec;
+}
+
+class Ring
+{
+public:
+    Ring(std::string const& path, uint32_t slot_count, uint32_t max_size) :
+        slot_count{slot_count},
+        slot_size{align(sizeof(ThumbnailSlotHeader) + 4*max_size*max_size)},
+        header_size{align(sizeof(ThumbnailRingHeader))},
+        size{header_size + size_t(slot_count)*slot_size}
+    {
+        // The thumbnails show what is on screen: other readers must be granted access explicitly (e.g. with an ACL)
+        mir::Fd const fd{open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC | O_NOFOLLOW, S_IRUSR | S_IWUSR)};
+
+        // The file may be left over from a run that created it with wider permissions
+        if (fd < 0 || fchmod(fd, S_IRUSR | S_IWUSR) < 0)
+        {
+            BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to open " + path}));
+        }
+
+        if (auto error = posix_fallocate(fd, 0, size))
+        {
+            BOOST_THROW_EXCEPTION((std::system_error{error, std::system_category(), "Failed to allocate " + path}));
+        }
+
+        if ((data = static_cast<char*>(mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0))) == MAP_FAILED)
+        {
+            BOOST_THROW_EXCEPTION((std::system_error{errno, std::system_category(), "Failed to mmap " + path}));
+        }
+
+        new (data) ThumbnailRingHeader{{'F', 'R', 'M', 'T', 'H', 'U', 'M', 'B'}, 1, slot_count, slot_size, header_size, {0}};
+
+        for (auto i = 0u; i != slot_count; ++i)
+        {
+            new (slot(i)) ThumbnailSlotHeader{};
+        }
+    }
+
+    ~Ring()
+    {
+        munmap(data, size);
+    }
+
+    Ring(Ring const&) = delete;
+    Ring& operator=(Ring const&) = delete;
+
+    // The single writer obtains the next slot, fills it in and then calls publish()
+    auto begin_write() -> ThumbnailSlotHeader*
+    {
+        auto const next = header()->write_count.load(std::memory_order_relaxed) % slot_count;
+        auto const slot_header = slot(next);
+        slot_header->sequence.fetch_add(1, std::memory_order_acq_rel);
+        std::atomic_thread_fence(std::memory_order_release);
+        return slot_header;
+    }
+
+    void publish(ThumbnailSlotHeader* slot_header)
+    {
+        slot_header->sequence.fetch_add(1, std::memory_order_release);
+        header()->write_count.fetch_add(1, std::memory_order_release);
+    }
+
+    static auto pixels_of(ThumbnailSlotHeader* slot_header) -> uint8_t*
+    {
+        return reinterpret_cast<uint8_t*>(slot_header + 1);
+    }
+
+private:
+    static auto align(size_t size) -> uint32_t { return (size + 63) & ~size_t{63}; }
+
+    auto header() const -> ThumbnailRingHeader* { return reinterpret_cast<ThumbnailRingHeader*>(data); }
+    auto slot(uint32_t i) const -> ThumbnailSlotHeader*
+    {
+        return reinterpret_cast<ThumbnailSlotHeader*>(data + header_size + size_t(i)*slot_size);
+    }
+
+    uint32_t const slot_count;
+    uint32_t const slot_size;
+    uint32_t const header_size;
+    size_t const size;
+    char* data;
+};
+
+// Downscale by an integer step, averaging a 2x2 block at each sample point. Reading 4 source pixels per
+// thumbnail pixel keeps the cost proportional to the thumbnail, not to the output.
+void downscale(Screencopy::Image const& image, int step, uint32_t width, uint32_t height, uint32_t* out)
+{
+    auto const source = static_cast<uint8_t const*>(image.pixels.get());
+    auto const offset = step > 1 ? 1 : 0;
+
+    for (auto y = 0u; y != height; ++y)
+    {
+        auto const sy = y*step;
+        auto const row0 = source + (image.y_invert ? image.height - 1 - sy : sy)*image.stride;
+        auto const row1 = source + (image.y_invert ? image.height - 1 - sy - offset : sy + offset)*image.stride;
+
+        for (auto x = 0u; x != width; ++x)
+        {
+            auto const sx = 4*x*step;
+            uint32_t pixel = 0;
+            for (auto c = 0; c != 3; ++c)
+            {
+                auto const sum = row0[sx + c] + row0[sx + 4*offset + c] + row1[sx + c] + row1[sx + 4*offset + c];
+                pixel |= uint32_t(sum / 4) << 8*c;
+            }
+            *out++ = pixel | 0xff000000;
+        }
+    }
+}
+
+auto checksum(std::vector<uint32_t> const& pixels) -> uint64_t
+{
+    uint64_t hash = 0xcbf29ce484222325;
+    for (auto pixel : pixels)
+    {
+        hash = (hash ^ pixel) * 0x100000001b3;
+    }
+    return hash;
+}
+}
+
+struct FrameThumbnails::Self : egmde::FullscreenClient
+{
+    Self(wl_display* display, FullscreenClient& host, std::string const& file, int interval, int max_size, int slot_count);
+
+    // We don't draw anything, we only track the outputs
+    void draw_screen(SurfaceInfo&) const override {}
+
+    void on_tick() override;
+
+    // Where an output was when its capture was requested
+    struct Placement
+    {
+        int32_t x, y, width, height;
+    };
+
+    struct Capture
+    {
+        uint64_t id = 0;
+        std::shared_ptr<Screencopy::Buffer> const buffer = Screencopy::make_buffer();
+        bool in_flight = false;
+        uint64_t last_checksum = 0;
+        std::vector<uint32_t> scratch;
+    };
+
+    // Captures complete after the output may have gone, so they identify it by the capture's id, not the Output
+    void store(uint64_t id, Placement const& placement, Screencopy::Image const& image);
+    auto capture_with(uint64_t id) -> Capture*;
+
+    int const max_size;
+    Ring ring;
+    Screencopy screencopy;
+
+    std::map<Output const*, Capture> captures;
+    uint64_t next_capture_id = 1;
+};
+
+FrameThumbnails::Self::Self(
+    wl_display* display, FullscreenClient& host, std::string const& file, int interval, int max_size, int slot_count) :
+    FullscreenClient(display, &host),
+    max_size{max_size},
+    ring{file, uint32_t(slot_count), uint32_t(max_size)},
+    screencopy{display, *this}
+{
+    wl_display_roundtrip(display);
+
+    set_tick_interval(std::chrono::seconds{interval});
+}
+
+void FrameThumbnails::Self::on_tick()
+{
+    decltype(captures) current;
+
+    for_each_output([&](Output const& output)
+        {
+            auto const existing = captures.find(&output);
+            auto& capture = existing != captures.end() ?
+                current.insert(captures.extract(existing)).position->second :
+                current[&output];
+
+            if (!capture.id)
+                capture.id = next_capture_id++;
+
+            // A capture waits for damage, so if the output hasn't changed the last one is still outstanding
+            if (capture.in_flight)
+                return;
+
+            capture.in_flight = true;
+            screencopy.capture(output.output, capture.buffer, true,
+                [this, id=capture.id, placement=Placement{output.x, output.y, output.width, output.height}]
+                (Screencopy::Image const& image)
+                {
+                    store(id, placement, image);
+                },
+                [this, id=capture.id]
+                {
+                    if (auto const capture = capture_with(id))
+                        capture->in_flight = false;
+                });
+        });
+
+    // Anything left over belongs to outputs that have gone. A capture still in flight for one of them is
+    // ignored when it completes.
+    captures = std::move(current);
+}
+
+auto FrameThumbnails::Self::capture_with(uint64_t id) -> Capture*
+{
+    for (auto& [_, capture] : captures)
+    {
+        if (capture.id == id)
+            return &capture;
+    }
+
+    return nullptr;
+}
+
+void FrameThumbnails::Self::store(uint64_t id, Placement const& placement, Screencopy::Image const& image)
+{
+    auto const p = capture_with(id);
+    if (!p)
+        return;
+
+    auto& capture = *p;
+    capture.in_flight = false;
+
+    auto const step = std::max((image.width + max_size - 1)/max_size, (image.height + max_size - 1)/max_size);
+    uint32_t const width = image.width/step;
+    uint32_t const height = image.height/step;
+
+    capture.scratch.resize(width*height);
+    downscale(image, step, width, height, capture.scratch.data());
+
+    // Damage doesn't guarantee a visible change (e.g. a cursor move), so only record what differs
+    auto const sum = checksum(capture.scratch);
+    if (sum == capture.last_checksum)
+        return;
+    capture.last_checksum = sum;
+
+    auto const slot = ring.begin_write();
+    slot->format = WL_SHM_FORMAT_XRGB8888;
+    slot->timestamp_ns = realtime_ns();
+    slot->output_x = placement.x;
+    slot->output_y = placement.y;
+    slot->output_width = placement.width;
+    slot->output_height = placement.height;
+    slot->width = width;
+    slot->height = height;
+    slot->stride = 4*width;
+    memcpy(Ring::pixels_of(slot), capture.scratch.data(), 4*capture.scratch.size());
+    ring.publish(slot);
+}
+
+auto FrameThumbnails::connect(wl_display* display, egmde::FullscreenClient& host)
+-> std::shared_ptr<egmde::FullscreenClient>
+{
+    std::string file;
+    int interval;
+    int size;
+    int count;
+    {
+        std::lock_guard<decltype(mutex)> lock{mutex};
+        file = ring_file.empty() ? default_file() : ring_file;
+        interval = interval_seconds;
+        size = max_size;
+        count = slot_count;
+    }
+
+    if (interval <= 0)
+        return {};
+
+    auto client = std::make_shared<Self>(display, host, file, interval, size, count);
+    mir::log_info("Writing output thumbnails to %s every %ds", file.c_str(), interval);
+    return client;
+}
+
+void FrameThumbnails::interval(int seconds)
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    interval_seconds = seconds;
+}
+
+void FrameThumbnails::size(int pixels)
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    max_size = std::clamp(pixels, 16, 1024);
+}
+
+void FrameThumbnails::slots(int count)
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    slot_count = std::clamp(count, 1, 256);
+}
+
+void FrameThumbnails::file(std::string const& option)
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    ring_file = option;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_THUMBNAILS_H
+#define FRAME_THUMBNAILS_H
+
+#include "frame_client_host.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/// The layout of the thumbnail ring file, for the benefit of readers.
+///
+/// The file is created readable only by Frame's user; other readers need to be granted access to it.
+///
+/// The file starts with a ThumbnailRingHeader followed by slot_count slots of slot_size bytes. Each slot starts
+/// with a ThumbnailSlotHeader followed by the pixels (XRGB8888, rows of stride bytes). The most recently written
+/// slot is (write_count - 1) % slot_count.
+///
+/// Slots are protected by a sequence lock: a reader should load sequence, skip the slot if it is odd, read the
+/// contents in place, then reload sequence and discard what it read if it changed.
+struct ThumbnailRingHeader
+{
+    char magic[8];                      // "FRMTHUMB"
+    uint32_t version;                   // 1
+    uint32_t slot_count;
+    uint32_t slot_size;
+    uint32_t header_size;               // offset of the first slot
+    std::atomic<uint64_t> write_count;
+};
+
+struct ThumbnailSlotHeader
+{
+    std::atomic<uint32_t> sequence;
+    uint32_t format;                    // wl_shm format
+    uint64_t timestamp_ns;              // CLOCK_REALTIME of the capture
+    int32_t output_x;                   // output position and size in the layout
+    int32_t output_y;
+    int32_t output_width;
+    int32_t output_height;
+    uint32_t width;                     // thumbnail size
+    uint32_t height;
+    uint32_t stride;
+    uint32_t reserved;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+    "ring file readers in other processes need lock free atomics");
+
+/// An internal client that periodically captures downscaled thumbnails of outputs that have changed into a
+/// memory mapped ring file
+class FrameThumbnails : public FrameHostedClient
+{
+public:
+    // Used in initialization
+    void interval(int seconds);
+    void size(int pixels);
+    void slots(int count);
+    void file(std::string const& option);
+
+private:
+    std::mutex mutable mutex;
+
+    int interval_seconds = 0;
+    int max_size = 256;
+    int slot_count = 8;
+    std::string ring_file;
+
+    struct Self;
+
+    auto connect(wl_display* display, egmde::FullscreenClient& host)
+    -> std::shared_ptr<egmde::FullscreenClient> override;
+};
+
+#endif // FRAME_THUMBNAILS_H
@@ -0,0 +1,57 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_TRACE_FORMAT_H
+#define FRAME_TRACE_FORMAT_H
+
+#include <cstdint>
+
+/// The window management trace file: the magic, then a Record per policy hook, each followed by value_count int32
+/// values. Everything is in host byte order.
+namespace frame_trace
+{
+char constexpr magic[8] = {'F', 'R', 'A', 'M', 'E', 'W', 'M', '1'};
+
+enum class Event : uint8_t
+{
+    place_window = 1,   // values: pid, type, state, x, y, width, height (unset are INT32_MIN)
+    new_window,         // values: pid, type, state, x, y, width, height
+    modify_window,      // values: state, x, y, width, height (unset are INT32_MIN), dropped
+    delete_window,      // no values
+    zone_create,        // values: x, y, width, height
+    zone_update,        // values: x, y, width, height
+    zone_delete,        // values: x, y, width, height
+    output_create,      // values: x, y, width, height, refresh rate in mHz
+    output_update,      // values: x, y, width, height, refresh rate in mHz
+    output_delete,      // values: x, y, width, height
+    end_of_transaction, // no values, handled_ns covers advise_end()
+};
+
+/// Windows are numbered in order of appearance, from 1. Zones and outputs use Mir's ids.
+struct Record
+{
+    Event event;
+    uint8_t value_count;
+    uint16_t reserved;
+    uint32_t object;
+    uint32_t since_previous_us;  // saturates
+    uint32_t handled_ns;         // time spent in the hook, saturates
+};
+
+static_assert(sizeof(Record) == 16, "Record is written as is");
+}
+
+#endif // FRAME_TRACE_FORMAT_H
@@ -0,0 +1,182 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frame_trace_recorder.h"
+
+#include <mir/log.h>
+
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+
+using namespace std::chrono;
+
+namespace
+{
+// A transaction's records are written out at its end, or before then if this much has accumulated
+auto constexpr write_size = 64*1024;
+
+auto saturated(Clock::duration duration, Clock::duration unit) -> uint32_t
+{
+    return static_cast<uint32_t>(std::clamp<Clock::rep>(duration/unit, 0, UINT32_MAX));
+}
+}
+
+FrameTraceRecorder::FrameTraceRecorder(miral::MirRunner& runner) :
+    runner{runner},
+    write_signal{eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)}
+{
+    runner.add_start_callback([this] { start(); });
+    runner.add_stop_callback([this]
+        {
+            {
+                std::lock_guard<decltype(mutex)> lock{mutex};
+                enabled = false;
+            }
+
+            write_handle.reset();
+            write_out();
+        });
+}
+
+FrameTraceRecorder::~FrameTraceRecorder() = default;
+
+void FrameTraceRecorder::file(std::string const& path)
+{
+    this->path = path;
+}
+
+void FrameTraceRecorder::start()
+{
+    if (path.empty())
+        return;
+
+    std::lock_guard<decltype(write_mutex)> write_lock{write_mutex};
+    std::lock_guard<decltype(mutex)> lock{mutex};
+
+    fd = mir::Fd{open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)};
+    if (fd < 0)
+    {
+        mir::log_warning("Failed to open window management trace %s: %s", path.c_str(), strerror(errno));
+        return;
+    }
+
+    mir::log_info("Recording window management trace to %s", path.c_str());
+
+    buffer.reserve(write_size + sizeof(frame_trace::Record) + UINT8_MAX*sizeof(int32_t));
+    writing.reserve(buffer.capacity());
+    buffer.insert(end(buffer), std::begin(frame_trace::magic), std::end(frame_trace::magic));
+
+    write_handle = runner.register_fd_handler(write_signal, [this](int signal)
+        {
+            eventfd_t ignored;
+            eventfd_read(signal, &ignored);
+            write_out();
+        });
+
+    previous = Clock::now();
+    enabled = true;
+}
+
+void FrameTraceRecorder::record(
+    frame_trace::Event event, uint32_t object, Clock::time_point started, std::initializer_list<int32_t> values)
+{
+    if (!enabled)
+        return;
+
+    auto const now = Clock::now();
+
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    if (!enabled)
+        return;
+
+    frame_trace::Record const record{
+        event,
+        static_cast<uint8_t>(values.size()),
+        0,
+        object,
+        saturated(started - previous, microseconds{1}),
+        saturated(now - started, nanoseconds{1})};
+    previous = started;
+
+    auto const bytes = reinterpret_cast<char const*>(&record);
+    buffer.insert(end(buffer), bytes, bytes + sizeof record);
+
+    auto const value_bytes = reinterpret_cast<char const*>(values.begin());
+    buffer.insert(end(buffer), value_bytes, value_bytes + values.size()*sizeof(int32_t));
+
+    if (event == frame_trace::Event::end_of_transaction || buffer.size() >= write_size)
+        schedule_write();
+}
+
+auto FrameTraceRecorder::id_of(miral::Window const& window) -> uint32_t
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    auto const [id, inserted] = window_ids.try_emplace(window, next_window_id);
+    if (inserted)
+        ++next_window_id;
+
+    return id->second;
+}
+
+void FrameTraceRecorder::forget(miral::Window const& window)
+{
+    std::lock_guard<decltype(mutex)> lock{mutex};
+    window_ids.erase(window);
+}
+
+void FrameTraceRecorder::schedule_write()
+{
+    // Called with mutex held. Signalling the eventfd doesn't wait for anything.
+    if (!write_pending)
+    {
+        write_pending = true;
+        eventfd_write(write_signal, 1);
+    }
+}
+
+void FrameTraceRecorder::write_out()
+{
+    std::lock_guard<decltype(write_mutex)> write_lock{write_mutex};
+    {
+        // Swapping keeps the storage of both buffers, so recording doesn't allocate
+        std::lock_guard<decltype(mutex)> lock{mutex};
+        std::swap(buffer, writing);
+        write_pending = false;
+    }
+
+    for (auto written = 0ul; written < writing.size();)
+    {
+        auto const result = write(fd, writing.data() + written, writing.size() - written);
+        if (result < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            mir::log_warning("Failed to write window management trace, stopping: %s", strerror(errno));
+            std::lock_guard<decltype(mutex)> lock{mutex};
+            enabled = false;
+            buffer.clear();
+            window_ids.clear();
+            break;
+        }
+        written += result;
+    }
+
+    writing.clear();
+}
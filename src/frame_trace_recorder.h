@@ -0,0 +1,90 @@
+/*
+ * Copyright © 2022 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * under the terms of the GNU General Public License version 2 or 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_TRACE_RECORDER_H
+#define FRAME_TRACE_RECORDER_H
+
+#include "frame_trace_format.h"
+
+#include <miral/runner.h>
+#include <miral/window.h>
+#include <mir/fd.h>
+
+#include <atomic>
+#include <chrono>
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// Records the window management policy's inputs, and the time it took to handle each, to a compact binary
+/// trace file (see frame_trace_format.h) for analysis with wm-trace-report
+class FrameTraceRecorder
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit FrameTraceRecorder(miral::MirRunner& runner);
+    ~FrameTraceRecorder();
+
+    // Used in initialization. An empty path disables recording.
+    void file(std::string const& path);
+
+    /// Whether records are wanted. Callers skip working out a record's values when they aren't.
+    auto recording() const -> bool { return enabled; }
+
+    /// When a hook started (only read if recording)
+    auto started() const -> Clock::time_point { return enabled ? Clock::now() : Clock::time_point{}; }
+
+    /// Appends a record for a hook that started at started. At the end of each transaction the records are handed
+    /// to the main loop to write out, so the caller never waits for the file.
+    void record(
+        frame_trace::Event event, uint32_t object, Clock::time_point started,
+        std::initializer_list<int32_t> values = {});
+
+    /// The number of a window in the trace
+    auto id_of(miral::Window const& window) -> uint32_t;
+    void forget(miral::Window const& window);
+
+private:
+    void start();
+    void schedule_write();
+    void write_out();
+
+    miral::MirRunner& runner;
+    std::string path;
+    std::atomic<bool> enabled{false};
+
+    // Signals the main loop to write out the buffer
+    mir::Fd const write_signal;
+    std::unique_ptr<miral::FdHandle> write_handle;
+
+    std::mutex mutex;
+    std::vector<char> buffer;
+    bool write_pending = false;
+    Clock::time_point previous;
+    std::map<miral::Window, uint32_t> window_ids;
+    uint32_t next_window_id = 1;
+
+    // Only used while writing out (on the main loop, or when stopping)
+    std::mutex write_mutex;
+    mir::Fd fd;
+    std::vector<char> writing;
+};
+
+#endif // FRAME_TRACE_RECORDER_H
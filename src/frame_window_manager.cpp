@@ -17,16 +17,32 @@
  */
 
 #include "frame_window_manager.h"
+#include "frame_authorization.h"
+#include "frame_hud.h"
+#include "frame_output_names.h"
+#include "frame_output_power_saver.h"
+#include "frame_render_monitor.h"
+#include "frame_settle_timer.h"
+#include "frame_standby_apps.h"
+#include "frame_statistics.h"
+#include "frame_trace_recorder.h"
 
 #include <miral/application_info.h>
 #include <miral/toolkit_event.h>
 #include <miral/window_info.h>
 #include <miral/window_manager_tools.h>
 
+#include <mir/log.h>
+
 #include <linux/input.h>
 #include <unistd.h>
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <sstream>
 
 namespace ms = mir::scene;
+using frame_trace::Event;
 using namespace miral;
 using namespace miral::toolkit;
 
@@ -74,25 +90,247 @@ bool override_state(WindowSpecification& spec, WindowInfo const& window_info)
 
     return true;
 }
+
+// Whether nothing but the state, position, size and output is set: anything else could matter to the client
+bool only_placement_set(WindowSpecification const& spec)
+{
+    return !(
+        spec.name().is_set() || spec.type().is_set() || spec.parent().is_set() || spec.depth_layer().is_set() ||
+        spec.preferred_orientation().is_set() || spec.aux_rect().is_set() || spec.placement_hints().is_set() ||
+        spec.window_placement_gravity().is_set() || spec.aux_rect_placement_gravity().is_set() ||
+        spec.aux_rect_placement_offset().is_set() ||
+        spec.min_width().is_set() || spec.min_height().is_set() ||
+        spec.max_width().is_set() || spec.max_height().is_set() ||
+        spec.width_inc().is_set() || spec.height_inc().is_set() ||
+        spec.min_aspect().is_set() || spec.max_aspect().is_set() ||
+        spec.streams().is_set() || spec.input_shape().is_set() || spec.input_mode().is_set() ||
+        spec.shell_chrome().is_set() || spec.confine_pointer().is_set() || spec.userdata().is_set() ||
+        spec.attached_edges().is_set() || spec.exclusive_rect().is_set() || spec.application_id().is_set());
+}
+
+// Whether a (rewritten) request only restates the window's current state, position and size
+bool unchanged_placement(WindowSpecification const& spec, WindowInfo const& window_info)
+{
+    auto const& window = window_info.window();
+
+    if (!spec.state().is_set() && !spec.top_left().is_set() && !spec.size().is_set())
+        return false;
+
+    if (!only_placement_set(spec))
+        return false;
+
+    return (!spec.state().is_set() || spec.state().value() == window_info.state()) &&
+        (!spec.top_left().is_set() || spec.top_left().value() == window.top_left()) &&
+        (!spec.size().is_set() || spec.size().value() == window.size());
+}
+
+// The HUD is one of our own windows, recognised by its title
+bool is_hud(Application const& application, std::string const& name)
+{
+    return pid_of(application) == getpid() && name == FrameHud::title;
+}
+
+// The optional placement of a request, as trace values
+struct TracedPlacement
+{
+    static auto constexpr unset = std::numeric_limits<int32_t>::min();
+
+    explicit TracedPlacement(WindowSpecification const& spec) :
+        state{spec.state().is_set() ? static_cast<int32_t>(spec.state().value()) : unset},
+        x{spec.top_left().is_set() ? spec.top_left().value().x.as_int() : unset},
+        y{spec.top_left().is_set() ? spec.top_left().value().y.as_int() : unset},
+        width{spec.size().is_set() ? spec.size().value().width.as_int() : unset},
+        height{spec.size().is_set() ? spec.size().value().height.as_int() : unset}
+    {
+    }
+
+    int32_t state, x, y, width, height;
+};
+
+// Standby applications are identified by their app id, or by name if they don't set one
+auto standby_name(WindowInfo const& window_info) -> std::string
+{
+    auto const& app_id = window_info.application_id();
+    return app_id.empty() ? name_of(window_info.window().application()) : app_id;
+}
+}
+
+auto parse_output_rules(std::string const& option) -> std::vector<FrameOutputRule>
+{
+    std::vector<FrameOutputRule> rules;
+
+    std::istringstream in{option};
+    for (std::string rule; std::getline(in, rule, ',');)
+    {
+        auto const colon = rule.find(':');
+        auto const equals = rule.rfind('=');
+
+        if (colon == std::string::npos || equals == std::string::npos || equals < colon)
+        {
+            if (!rule.empty())
+                mir::log_warning("Ignoring output rule '%s' (expected <app-id|snap|pid>:<value>=<output>)", rule.c_str());
+            continue;
+        }
+
+        auto const key = rule.substr(0, colon);
+        auto const value = rule.substr(colon + 1, equals - colon - 1);
+        auto const output = rule.substr(equals + 1);
+
+        if (key == "app-id")
+        {
+            rules.push_back({FrameOutputRule::Match::app_id, value, output});
+        }
+        else if (key == "snap")
+        {
+            rules.push_back({FrameOutputRule::Match::snap, value, output});
+        }
+        else if (key == "pid")
+        {
+            rules.push_back({FrameOutputRule::Match::pid, value, output});
+        }
+        else
+        {
+            mir::log_warning("Ignoring output rule '%s' (expected <app-id|snap|pid>:<value>=<output>)", rule.c_str());
+        }
+    }
+
+    return rules;
+}
+
+FrameWindowManagerPolicy::FrameWindowManagerPolicy(
+    WindowManagerTools const& tools, RenderMonitor& render_monitor, FrameHud& hud,
+    FrameSettleTimer& zone_settle_timer, FrameOutputPowerSaver& power_saver, FrameStandbyApps& standby_apps,
+    FrameTraceRecorder& trace, FrameOutputNames const& output_names, FrameWindowManagerOptions const& options) :
+    MinimalWindowManager{tools},
+    render_monitor{render_monitor},
+    hud{hud},
+    zone_settle_timer{zone_settle_timer},
+    power_saver{power_saver},
+    standby_apps{standby_apps},
+    trace{trace},
+    output_names{output_names},
+    options{options}
+{
+    standby_apps.on_switch([this](std::string const& app)
+        {
+            this->tools.invoke_under_lock([this, app] { switch_to(app); });
+        });
+}
+
+FrameWindowManagerPolicy::~FrameWindowManagerPolicy()
+{
+    standby_apps.on_switch({});
+    zone_settle_timer.cancel();
 }
 
 bool FrameWindowManagerPolicy::handle_keyboard_event(MirKeyboardEvent const* event)
 {
+    auto const ctrl_alt = mir_input_event_modifier_ctrl | mir_input_event_modifier_alt;
+    auto const action = mir_keyboard_event_action(event);
+
+    if (mir_keyboard_event_scan_code(event) != KEY_H)
+        return false;
+
+    // The application didn't see the press, so it mustn't see the repeats or the release
+    if (hud_key_down)
+    {
+        if (action == mir_keyboard_action_up)
+            hud_key_down = false;
+
+        return true;
+    }
+
+    // Ctrl+Alt+H toggles the performance HUD
+    if (action == mir_keyboard_action_down &&
+        (mir_keyboard_event_modifiers(event) & ctrl_alt) == ctrl_alt)
+    {
+        hud_key_down = hud.toggle();
+        return hud_key_down;
+    }
+
     return false;
 }
 
+void FrameWindowManagerPolicy::handle_window_ready(WindowInfo& window_info)
+{
+    // The HUD mustn't take focus from the application
+    if (is_hud(window_info.window().application(), window_info.name()))
+        return;
+
+    // A standby window is drawn at its fullscreen size underneath the active application, ready to be switched to
+    if (on_standby(window_info))
+    {
+        tools.send_tree_to_back(window_info.window());
+        return;
+    }
+
+    MinimalWindowManager::handle_window_ready(window_info);
+}
+
+void FrameWindowManagerPolicy::handle_raise_window(WindowInfo& window_info)
+{
+    // Standby windows only come forward when their application is activated
+    if (on_standby(window_info))
+        return;
+
+    unocclude(window_info);
+    MinimalWindowManager::handle_raise_window(window_info);
+}
+
+auto FrameWindowManagerPolicy::on_standby(WindowInfo const& window_info) const -> bool
+{
+    auto const app = standby_name(window_info);
+
+    // The first standby window shown is active until told otherwise
+    return standby_apps.is_standby(app) && app != standby_apps.active() && tools.active_window();
+}
+
+void FrameWindowManagerPolicy::switch_to(std::string const& app)
+{
+    Window standby_window;
+
+    tools.for_each_application([&](auto& app_info)
+        {
+            for (auto& window : app_info.windows())
+            {
+                if (!standby_window && window)
+                {
+                    auto& info = tools.info_for(window);
+                    if (info.state() == mir_window_state_fullscreen && standby_name(info) == app)
+                        standby_window = window;
+                }
+            }
+        });
+
+    if (standby_window)
+    {
+        // It is already placed and has a buffer, so raising it is all that's needed to show it in the next frame
+        unocclude(tools.info_for(standby_window));
+        tools.select_active_window(standby_window);
+    }
+    else
+    {
+        mir::log_info("No window for application \"%s\" yet, it will be shown when ready", app.c_str());
+    }
+}
+
 auto FrameWindowManagerPolicy::place_new_window(ApplicationInfo const& app_info, WindowSpecification const& request)
 -> WindowSpecification
 {
+    auto const started = trace.started();
     WindowSpecification specification = MinimalWindowManager::place_new_window(app_info, request);
 
     {
         WindowInfo window_info{};
         if (override_state(specification, window_info))
         {
-            specification.state() = mir_window_state_maximized;
-            tools.place_and_size_for_state(specification, window_info);
-            specification.state() = mir_window_state_fullscreen;
+            // Placing the window on its output now saves the client a second configure (and buffers) when moved
+            if (auto const output = rule_output(app_info, request))
+            {
+                specification.output_id() = output->id();
+            }
+
+            place_fullscreen(specification, window_info);
         }
     }
 
@@ -101,7 +339,23 @@ auto FrameWindowManagerPolicy::place_new_window(ApplicationInfo const& app_info,
     // for that extension
     if (pid_of(app_info.application()) == getpid())
     {
-        specification.depth_layer() = mir_depth_layer_background;
+        // ...apart from the HUD, which goes over the applications
+        auto const hud = request.name().is_set() && is_hud(app_info.application(), request.name().value());
+        specification.depth_layer() = hud ? mir_depth_layer_overlay : mir_depth_layer_background;
+    }
+    else if (specification.top_left().is_set() && specification.size().is_set())
+    {
+        // Don't make the client wait for the next check to see its output powered up
+        power_saver.placing({specification.top_left().value(), specification.size().value()});
+    }
+
+    if (trace.recording())
+    {
+        TracedPlacement const placement{request};
+        auto const type = request.type().is_set() ? static_cast<int32_t>(request.type().value()) : placement.unset;
+        trace.record(Event::place_window, 0, started, {
+            pid_of(app_info.application()), type,
+            placement.state, placement.x, placement.y, placement.width, placement.height});
     }
 
     return specification;
@@ -109,16 +363,39 @@ auto FrameWindowManagerPolicy::place_new_window(ApplicationInfo const& app_info,
 
 void FrameWindowManagerPolicy::handle_modify_window(WindowInfo& window_info, WindowSpecification const& modifications)
 {
+    auto const started = trace.started();
     WindowSpecification specification = modifications;
 
+    // A hidden window's client may not change its placement: it is placed fullscreen when shown again
+    if (occluded.count(window_info.window()))
+    {
+        specification.state() = mir::optional_value<MirWindowState>{};
+        specification.top_left() = mir::optional_value<Point>{};
+        specification.size() = mir::optional_value<Size>{};
+    }
+
     if (override_state(specification, window_info))
     {
-        specification.state() = mir_window_state_maximized;
-        tools.place_and_size_for_state(specification, window_info);
-        specification.state() = mir_window_state_fullscreen;
+        place_fullscreen(specification, window_info);
+    }
+
+    // Some clients request the state they already have in a tight loop, and each costs a configure
+    auto const dropped = unchanged_placement(specification, window_info) && !modify_allowed(window_info);
+    if (dropped)
+    {
+        frame_statistics.modify_request_dropped(name_of(window_info.window().application()));
+    }
+    else
+    {
+        MinimalWindowManager::handle_modify_window(window_info, specification);
     }
 
-    MinimalWindowManager::handle_modify_window(window_info, specification);
+    if (trace.recording())
+    {
+        TracedPlacement const placement{modifications};
+        trace.record(Event::modify_window, trace.id_of(window_info.window()), started, {
+            placement.state, placement.x, placement.y, placement.width, placement.height, dropped ? 1 : 0});
+    }
 }
 
 auto FrameWindowManagerPolicy::confirm_placement_on_display(
@@ -129,8 +406,7 @@ auto FrameWindowManagerPolicy::confirm_placement_on_display(
     if (new_state == mir_window_state_fullscreen)
     {
         WindowSpecification specification;
-        specification.state() = mir_window_state_maximized;
-        tools.place_and_size_for_state(specification, window_info);
+        place_fullscreen(specification, window_info);
         return {specification.top_left().value(), specification.size().value()};
     }
     return new_placement;
@@ -143,47 +419,379 @@ void FrameWindowManagerPolicy::advise_begin()
 
 void FrameWindowManagerPolicy::advise_end()
 {
+    auto const started = trace.started();
     WindowManagementPolicy::advise_end();
-    if (application_zones_have_changed)
+
+    // Overlaid fullscreen windows don't depend on the application zones
+    if (application_zones_have_changed && !options.osk_overlay)
+    {
+        if (zone_settle_timer.settles())
+        {
+            // Zones can change every frame (e.g. while an OSK slides in), so only resize the windows once they settle
+            zone_settle_timer.arm([this] { tools.invoke_under_lock([this] { relayout_fullscreen_windows(); }); });
+        }
+        else
+        {
+            relayout_fullscreen_windows();
+        }
+    }
+
+    application_zones_have_changed = false;
+
+    if (windows_have_changed)
     {
-        tools.for_each_application([this](auto& app)
+        if (options.hide_occluded)
+            update_occlusion();
+
+        report_window_areas();
+        windows_have_changed = false;
+    }
+
+    trace.record(Event::end_of_transaction, 0, started);
+}
+
+void FrameWindowManagerPolicy::update_occlusion()
+{
+    // We don't know the stacking order of every window, but the active window is raised above its peers
+    auto const active = tools.active_window();
+    auto const active_info = active ? &tools.info_for(active) : nullptr;
+    auto const covering = active_info &&
+        active_info->state() == mir_window_state_fullscreen &&
+        pid_of(active.application()) != getpid();
+    Rectangle const cover = active ? Rectangle{active.top_left(), active.size()} : Rectangle{};
+    Window shown;
+
+    tools.for_each_application([&](auto& app)
+        {
+            if (pid_of(app.application()) == getpid())
+                return;
+
+            for (auto& window : app.windows())
             {
-               for (auto& window : app.windows())
+                if (!window || window == active)
+                    continue;
+
+                auto& info = tools.info_for(window);
+
+                if (occluded.count(window))
+                {
+                    if (!covering || !cover.contains(Rectangle{window.top_left(), window.size()}))
+                    {
+                        unocclude(info);
+                        shown = window;
+                    }
+                }
+                else if (covering &&
+                    info.state() == mir_window_state_fullscreen &&
+                    cover.contains(Rectangle{window.top_left(), window.size()}))
+                {
+                    // Hidden windows aren't composited, so clients pacing themselves with frame callbacks stop rendering
+                    WindowSpecification specification;
+                    specification.state() = mir_window_state_hidden;
+                    tools.modify_window(info, specification);
+                    occluded.insert(window);
+                }
+            }
+        });
+
+    // Hidden windows can't take focus, so if the active window went away give it to one we've shown
+    if (!active && shown)
+    {
+        tools.select_active_window(shown);
+    }
+}
+
+void FrameWindowManagerPolicy::unocclude(WindowInfo& window_info)
+{
+    if (!occluded.erase(window_info.window()))
+        return;
+
+    // The window keeps its fullscreen size while hidden, so this needs no resize
+    WindowSpecification specification;
+    place_fullscreen(specification, window_info);
+    tools.modify_window(window_info, specification);
+}
+
+void FrameWindowManagerPolicy::report_window_areas()
+{
+    std::vector<Rectangle> areas;
+
+    tools.for_each_application([&](auto& app)
+        {
+            // Our own windows (the wallpaper and HUD) don't keep an output in use
+            if (pid_of(app.application()) == getpid())
+                return;
+
+            for (auto& window : app.windows())
+            {
+                if (window && tools.info_for(window).is_visible())
+                {
+                    areas.emplace_back(window.top_left(), window.size());
+                }
+            }
+        });
+
+    power_saver.windows(std::move(areas));
+}
+
+auto FrameWindowManagerPolicy::modify_allowed(WindowInfo const& window_info) -> bool
+{
+    if (options.modify_rate_limit <= 0)
+        return true;
+
+    auto const now = std::chrono::steady_clock::now();
+    double const rate = options.modify_rate_limit;
+
+    auto& bucket = modify_buckets.try_emplace(window_info.window(), ModifyBucket{rate, now}).first->second;
+    bucket.tokens = std::min(rate, bucket.tokens + rate*std::chrono::duration<double>{now - bucket.refilled}.count());
+    bucket.refilled = now;
+
+    if (bucket.tokens >= 1)
+    {
+        bucket.tokens -= 1;
+        bucket.limited = false;
+        return true;
+    }
+
+    if (!bucket.limited)
+    {
+        bucket.limited = true;
+        mir::log_info(
+            "Dropping repeated state changes from \"%s\" (%s): more than %d a second",
+            window_info.name().c_str(), name_of(window_info.window().application()).c_str(), options.modify_rate_limit);
+    }
+
+    return false;
+}
+
+void FrameWindowManagerPolicy::place_fullscreen(WindowSpecification& specification, WindowInfo const& window_info)
+{
+    // Mir places maximized windows in the application zone
+    specification.state() = options.osk_overlay ? mir_window_state_fullscreen : mir_window_state_maximized;
+    tools.place_and_size_for_state(specification, window_info);
+    specification.state() = mir_window_state_fullscreen;
+
+    // If the placement isn't on the requested output, use the whole output
+    if (specification.output_id().is_set())
+    {
+        auto const id = specification.output_id().value();
+        auto const output = std::find_if(begin(outputs), end(outputs), [id](auto const& o) { return o.id() == id; });
+
+        if (output != end(outputs) &&
+            !output->extents().contains(Rectangle{specification.top_left().value(), specification.size().value()}))
+        {
+            specification.top_left() = output->extents().top_left;
+            specification.size() = output->extents().size;
+        }
+    }
+}
+
+auto FrameWindowManagerPolicy::rule_output(ApplicationInfo const& app_info, WindowSpecification const& request) const
+-> Output const*
+{
+    if (options.output_rules.empty())
+        return nullptr;
+
+    auto const pid = pid_of(app_info.application());
+    auto const app_id = request.application_id().is_set() ? request.application_id().value() : std::string{};
+    std::string snap;
+
+    for (auto const& rule : options.output_rules)
+    {
+        bool matched = false;
+        switch (rule.match)
+        {
+        case FrameOutputRule::Match::app_id:
+            matched = rule.value == app_id;
+            break;
+
+        case FrameOutputRule::Match::snap:
+            if (snap.empty())
+                snap = snap_name_of(app_info.application());
+            matched = rule.value == snap;
+            break;
+
+        case FrameOutputRule::Match::pid:
+            matched = rule.value == std::to_string(pid);
+            break;
+        }
+
+        if (!matched)
+            continue;
+
+        if (auto const id = output_names.id_of(rule.output))
+        {
+            auto const output = std::find_if(begin(outputs), end(outputs), [&](auto const& o) { return o.id() == id; });
+            if (output != end(outputs))
+                return &*output;
+        }
+
+        mir::log_info("Output rule for \"%s\": no output %s", rule.value.c_str(), rule.output.c_str());
+        return nullptr;
+    }
+
+    return nullptr;
+}
+
+void FrameWindowManagerPolicy::relayout_fullscreen_windows()
+{
+    tools.for_each_application([this](auto& app)
+        {
+           for (auto& window : app.windows())
+           {
+               if (window)
                {
-                   if (window)
+                   auto& info = tools.info_for(window);
+
+                   if (info.state() == mir_window_state_fullscreen)
                    {
-                       auto& info = tools.info_for(window);
-
-                       if (info.state() == mir_window_state_fullscreen)
-                       {
-                           WindowSpecification specification;
-                           specification.state() = mir_window_state_maximized;
-                           tools.place_and_size_for_state(specification, info);
-                           specification.state() = mir_window_state_fullscreen;
-                           tools.modify_window(info, specification);
-                       }
+                       WindowSpecification specification;
+                       place_fullscreen(specification, info);
+                       tools.modify_window(info, specification);
+                       ++frame_statistics.fullscreen_relayouts;
                    }
                }
-            });
-
-        application_zones_have_changed = false;
-    }
+           }
+        });
 }
 
 void FrameWindowManagerPolicy::advise_application_zone_create(Zone const& application_zone)
 {
+    auto const started = trace.started();
     WindowManagementPolicy::advise_application_zone_create(application_zone);
     application_zones_have_changed = true;
+    ++frame_statistics.application_zone_changes;
+
+    auto const& area = application_zone.extents();
+    trace.record(Event::zone_create, application_zone.id(), started, {
+        area.top_left.x.as_int(), area.top_left.y.as_int(), area.size.width.as_int(), area.size.height.as_int()});
 }
 
 void FrameWindowManagerPolicy::advise_application_zone_update(Zone const& updated, Zone const& original)
 {
+    auto const started = trace.started();
     WindowManagementPolicy::advise_application_zone_update(updated, original);
     application_zones_have_changed = true;
+    ++frame_statistics.application_zone_changes;
+
+    auto const& area = updated.extents();
+    trace.record(Event::zone_update, updated.id(), started, {
+        area.top_left.x.as_int(), area.top_left.y.as_int(), area.size.width.as_int(), area.size.height.as_int()});
 }
 
 void FrameWindowManagerPolicy::advise_application_zone_delete(Zone const& application_zone)
 {
+    auto const started = trace.started();
     WindowManagementPolicy::advise_application_zone_delete(application_zone);
     application_zones_have_changed = true;
+    ++frame_statistics.application_zone_changes;
+
+    auto const& area = application_zone.extents();
+    trace.record(Event::zone_delete, application_zone.id(), started, {
+        area.top_left.x.as_int(), area.top_left.y.as_int(), area.size.width.as_int(), area.size.height.as_int()});
+}
+
+void FrameWindowManagerPolicy::advise_new_window(WindowInfo const& window_info)
+{
+    auto const started = trace.started();
+    MinimalWindowManager::advise_new_window(window_info);
+    frame_statistics.window_created(name_of(window_info.window().application()));
+    windows_have_changed = true;
+
+    if (trace.recording())
+    {
+        auto const& window = window_info.window();
+        trace.record(Event::new_window, trace.id_of(window), started, {
+            pid_of(window.application()),
+            static_cast<int32_t>(window_info.type()), static_cast<int32_t>(window_info.state()),
+            window.top_left().x.as_int(), window.top_left().y.as_int(),
+            window.size().width.as_int(), window.size().height.as_int()});
+    }
+}
+
+void FrameWindowManagerPolicy::advise_delete_window(WindowInfo const& window_info)
+{
+    auto const started = trace.started();
+    MinimalWindowManager::advise_delete_window(window_info);
+    modify_buckets.erase(window_info.window());
+    occluded.erase(window_info.window());
+    frame_statistics.window_deleted(name_of(window_info.window().application()));
+    windows_have_changed = true;
+
+    if (trace.recording())
+    {
+        trace.record(Event::delete_window, trace.id_of(window_info.window()), started);
+        trace.forget(window_info.window());
+    }
+}
+
+void FrameWindowManagerPolicy::advise_state_change(WindowInfo const& window_info, MirWindowState state)
+{
+    MinimalWindowManager::advise_state_change(window_info, state);
+    windows_have_changed = true;
+}
+
+void FrameWindowManagerPolicy::advise_move_to(WindowInfo const& window_info, Point top_left)
+{
+    MinimalWindowManager::advise_move_to(window_info, top_left);
+    windows_have_changed = true;
+}
+
+void FrameWindowManagerPolicy::advise_resize(WindowInfo const& window_info, Size const& new_size)
+{
+    MinimalWindowManager::advise_resize(window_info, new_size);
+    windows_have_changed = true;
+}
+
+void FrameWindowManagerPolicy::advise_focus_gained(WindowInfo const& window_info)
+{
+    MinimalWindowManager::advise_focus_gained(window_info);
+    windows_have_changed = true;
+}
+
+void FrameWindowManagerPolicy::advise_output_create(Output const& output)
+{
+    auto const started = trace.started();
+    WindowManagementPolicy::advise_output_create(output);
+    render_monitor.set_refresh_rate(output.extents(), output.refresh_rate());
+    outputs.push_back(output);
+
+    auto const& area = output.extents();
+    trace.record(Event::output_create, output.id(), started, {
+        area.top_left.x.as_int(), area.top_left.y.as_int(), area.size.width.as_int(), area.size.height.as_int(),
+        static_cast<int32_t>(output.refresh_rate()*1000)});
+}
+
+void FrameWindowManagerPolicy::advise_output_update(Output const& updated, Output const& original)
+{
+    auto const started = trace.started();
+    WindowManagementPolicy::advise_output_update(updated, original);
+    if (updated.extents() != original.extents())
+        render_monitor.remove_refresh_rate(original.extents());
+    render_monitor.set_refresh_rate(updated.extents(), updated.refresh_rate());
+
+    for (auto& output : outputs)
+    {
+        if (output.is_same_output(original))
+            output = updated;
+    }
+
+    auto const& area = updated.extents();
+    trace.record(Event::output_update, updated.id(), started, {
+        area.top_left.x.as_int(), area.top_left.y.as_int(), area.size.width.as_int(), area.size.height.as_int(),
+        static_cast<int32_t>(updated.refresh_rate()*1000)});
+}
+
+void FrameWindowManagerPolicy::advise_output_delete(Output const& output)
+{
+    auto const started = trace.started();
+    WindowManagementPolicy::advise_output_delete(output);
+    render_monitor.remove_refresh_rate(output.extents());
+    outputs.erase(
+        std::remove_if(begin(outputs), end(outputs), [&](auto const& o) { return o.is_same_output(output); }),
+        end(outputs));
+
+    auto const& area = output.extents();
+    trace.record(Event::output_delete, output.id(), started, {
+        area.top_left.x.as_int(), area.top_left.y.as_int(), area.size.width.as_int(), area.size.height.as_int()});
 }
@@ -20,20 +20,72 @@
 #define MIRAL_X11_KIOSK_WINDOW_MANAGER_H
 
 #include <miral/minimal_window_manager.h>
+#include <miral/output.h>
 
 #include <mir_toolkit/events/enums.h>
 
+#include <chrono>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
 using namespace mir::geometry;
 
+class FrameHud;
+class FrameOutputNames;
+class FrameOutputPowerSaver;
+class FrameSettleTimer;
+class FrameStandbyApps;
+class FrameTraceRecorder;
+class RenderMonitor;
+
+/// Puts new fullscreen windows of matching clients on an output named as in the display layout (e.g. "HDMI-A-1")
+struct FrameOutputRule
+{
+    enum class Match { app_id, snap, pid };
+
+    Match match;
+    std::string value;
+    std::string output;
+};
+
+/// Parses comma separated "<app-id|snap|pid>:<value>=<output>" rules, logging any that don't parse
+auto parse_output_rules(std::string const& option) -> std::vector<FrameOutputRule>;
+
+/// Window management choices made by options (set in initialization)
+struct FrameWindowManagerOptions
+{
+    // Fullscreen windows keep the whole output with layer-shell clients (e.g. the OSK) shown over them, rather than
+    // being resized to the application zone
+    bool osk_overlay = false;
+
+    // Requests per second (and burst) allowed from each window that would leave its placement unchanged (0 for
+    // no limit)
+    int modify_rate_limit = 10;
+
+    // Fullscreen windows covered by the active fullscreen window are hidden, so their clients can stop rendering
+    bool hide_occluded = false;
+
+    // Outputs for the windows of particular clients, applied before their first configure
+    std::vector<FrameOutputRule> output_rules;
+};
+
 class FrameWindowManagerPolicy : public miral::MinimalWindowManager
 {
 public:
-    using miral::MinimalWindowManager::MinimalWindowManager;
+    FrameWindowManagerPolicy(
+        miral::WindowManagerTools const& tools, RenderMonitor& render_monitor, FrameHud& hud,
+        FrameSettleTimer& zone_settle_timer, FrameOutputPowerSaver& power_saver, FrameStandbyApps& standby_apps,
+        FrameTraceRecorder& trace, FrameOutputNames const& output_names, FrameWindowManagerOptions const& options);
+    ~FrameWindowManagerPolicy();
 
     auto place_new_window(miral::ApplicationInfo const& app_info, miral::WindowSpecification const& request)
     -> miral::WindowSpecification override;
 
     bool handle_keyboard_event(MirKeyboardEvent const* event) override;
+    void handle_window_ready(miral::WindowInfo& window_info) override;
+    void handle_raise_window(miral::WindowInfo& window_info) override;
     void handle_modify_window(miral::WindowInfo& window_info, miral::WindowSpecification const& modifications) override;
 
     auto confirm_placement_on_display(const miral::WindowInfo& window_info, MirWindowState new_state,
@@ -45,8 +97,75 @@ public:
     void advise_application_zone_update(miral::Zone const& updated, miral::Zone const& original) override;
     void advise_application_zone_delete(miral::Zone const& application_zone) override;
 
+    void advise_new_window(miral::WindowInfo const& window_info) override;
+    void advise_delete_window(miral::WindowInfo const& window_info) override;
+    void advise_state_change(miral::WindowInfo const& window_info, MirWindowState state) override;
+    void advise_move_to(miral::WindowInfo const& window_info, Point top_left) override;
+    void advise_resize(miral::WindowInfo const& window_info, Size const& new_size) override;
+    void advise_focus_gained(miral::WindowInfo const& window_info) override;
+
+    void advise_output_create(miral::Output const& output) override;
+    void advise_output_update(miral::Output const& updated, miral::Output const& original) override;
+    void advise_output_delete(miral::Output const& output) override;
+
 private:
+    RenderMonitor& render_monitor;
+    FrameHud& hud;
+    FrameSettleTimer& zone_settle_timer;
+    FrameOutputPowerSaver& power_saver;
+    FrameStandbyApps& standby_apps;
+    FrameTraceRecorder& trace;
+    FrameOutputNames const& output_names;
+    FrameWindowManagerOptions const options;
+
     bool application_zones_have_changed = false;
+    bool windows_have_changed = false;
+
+    // Whether the H of a Ctrl+Alt+H that toggled the HUD is still down (its repeats and release are consumed too)
+    bool hud_key_down = false;
+
+    // Tells the power saver where the visible client windows are
+    void report_window_areas();
+
+    // Whether the window belongs to a standby application other than the active one
+    auto on_standby(miral::WindowInfo const& window_info) const -> bool;
+
+    // Brings the (already placed) window of a standby application to the front
+    void switch_to(std::string const& app);
+
+    // Windows we have hidden because the active window covers them
+    std::set<miral::Window> occluded;
+
+    // Hides fullscreen windows covered by the active window, and shows those no longer covered
+    void update_occlusion();
+
+    // Shows a window we hid (if we did), returning it to its fullscreen placement
+    void unocclude(miral::WindowInfo& window_info);
+
+    std::vector<miral::Output> outputs;
+
+    // The output a rule assigns to new windows of the application, if any
+    auto rule_output(miral::ApplicationInfo const& app_info, miral::WindowSpecification const& request) const
+    -> miral::Output const*;
+
+    // Resizes fullscreen windows to the current application zones
+    void relayout_fullscreen_windows();
+
+    // Token buckets for modify requests that wouldn't change the window's placement
+    struct ModifyBucket
+    {
+        double tokens;
+        std::chrono::steady_clock::time_point refilled;
+        bool limited = false;
+    };
+
+    std::map<miral::Window, ModifyBucket> modify_buckets;
+
+    // Whether a request leaving the placement unchanged is within the window's rate limit
+    auto modify_allowed(miral::WindowInfo const& window_info) -> bool;
+
+    // Sets the fullscreen placement: the application zone or (with osk_overlay) the output
+    void place_fullscreen(miral::WindowSpecification& specification, miral::WindowInfo const& window_info);
 };
 
 #endif /* MIRAL_X11_KIOSK_WINDOW_MANAGER_H */